@@ -4,6 +4,8 @@
 #  FFTW_INCLUDES    - where to find fftw3.h
 #  FFTW_LIBRARIES   - List of libraries when using FFTW.
 #  FFTW_FOUND       - True if FFTW found.
+#  FFTW_THREADS_FOUND - True if the fftw3f_threads library was found
+#                       (and added to FFTW_LIBRARIES).
 
 if (FFTW_INCLUDES)
   # Already in cache, be silent
@@ -19,9 +21,20 @@ find_path (FFTW_INCLUDES fftw3.h
 find_library (FFTW_LIBRARIES NAMES fftw3f
     HINTS ${PC_FFTW_LIBDIR} ${PC_FFTW_LIBRARY_DIRS})
 
+find_library (FFTW_THREADS_LIBRARIES NAMES fftw3f_threads
+    HINTS ${PC_FFTW_LIBDIR} ${PC_FFTW_LIBRARY_DIRS})
+
+if (FFTW_THREADS_LIBRARIES)
+  set (FFTW_THREADS_FOUND TRUE)
+endif (FFTW_THREADS_LIBRARIES)
+
 # handle the QUIETLY and REQUIRED arguments and set FFTW_FOUND to TRUE if
 # all listed variables are TRUE
 include (FindPackageHandleStandardArgs)
 find_package_handle_standard_args (FFTW DEFAULT_MSG FFTW_LIBRARIES FFTW_INCLUDES)
 
-mark_as_advanced (FFTW_LIBRARIES FFTW_INCLUDES)
+if (FFTW_THREADS_FOUND)
+  set (FFTW_LIBRARIES ${FFTW_THREADS_LIBRARIES} ${FFTW_LIBRARIES})
+endif (FFTW_THREADS_FOUND)
+
+mark_as_advanced (FFTW_LIBRARIES FFTW_THREADS_LIBRARIES FFTW_INCLUDES)
@@ -18,6 +18,7 @@
  */
 
 #include "amplitudedemod.h"
+#include "kernels.h"
 
 AmplitudeDemod::AmplitudeDemod(std::shared_ptr<SampleSource<std::complex<float>>> src) : SampleBuffer(src)
 {
@@ -28,6 +29,5 @@ void AmplitudeDemod::work(void *input, void *output, int count, size_t sampleid)
 {
     auto in = static_cast<std::complex<float>*>(input);
     auto out = static_cast<float*>(output);
-    std::transform(in, in + count, out,
-                   [](std::complex<float> s) { return std::norm(s) * 2.0f - 1.0f; });
+    amplitudeComplex(in, out, count);
 }
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "asyncrequest.h"
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+
+class AsyncRequest::Runnable : public QRunnable
+{
+public:
+    Runnable(std::shared_ptr<AsyncRequest> request, std::function<void(AsyncRequest&)> job)
+        : request(request), job(job) { }
+
+    void run() override {
+        request->started = true;
+        if (!request->isCancelled())
+            job(*request);
+        request->finish();
+    }
+
+private:
+    std::shared_ptr<AsyncRequest> request;
+    std::function<void(AsyncRequest&)> job;
+};
+
+std::shared_ptr<AsyncRequest> AsyncRequest::run(std::function<void(AsyncRequest&)> job, int priority)
+{
+    auto request = std::make_shared<AsyncRequest>();
+    QThreadPool::globalInstance()->start(new Runnable(request, job), priority);
+    return request;
+}
+
+void AsyncRequest::cancel()
+{
+    cancelled = true;
+}
+
+bool AsyncRequest::isCancelled() const
+{
+    return cancelled;
+}
+
+bool AsyncRequest::isStarted() const
+{
+    return started;
+}
+
+bool AsyncRequest::isFinished()
+{
+    QMutexLocker ml(&mutex);
+    return finished;
+}
+
+void AsyncRequest::waitForFinished()
+{
+    QMutexLocker ml(&mutex);
+    while (!finished)
+        finishedCondition.wait(&mutex);
+}
+
+void AsyncRequest::finish()
+{
+    QMutexLocker ml(&mutex);
+    finished = true;
+    finishedCondition.wakeAll();
+}
+
+void RetiredRequests::add(std::shared_ptr<AsyncRequest> request)
+{
+    request->cancel();
+    // Forget the ones that have finished since, so this stays short
+    requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                  [](const std::shared_ptr<AsyncRequest> &r) { return r->isFinished(); }),
+                   requests.end());
+    requests.push_back(request);
+}
+
+void RetiredRequests::waitForFinished()
+{
+    for (auto &request : requests)
+        request->waitForFinished();
+    requests.clear();
+}
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * Handle to a job queued on the global thread pool.
+ *
+ * Cancelling a request that hasn't started yet means it never runs;
+ * long jobs can also poll isCancelled() and bail out early.
+ */
+class AsyncRequest
+{
+public:
+    // Higher priorities are picked off the queue first
+    enum Priority {
+        Prefetch = 0,
+        Normal = 1,
+        Visible = 2,
+    };
+
+    static std::shared_ptr<AsyncRequest> run(std::function<void(AsyncRequest&)> job, int priority = Normal);
+
+    void cancel();
+    bool isCancelled() const;
+    // True once a pool thread has picked the job up
+    bool isStarted() const;
+    bool isFinished();
+    void waitForFinished();
+
+private:
+    class Runnable;
+
+    void finish();
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> started{false};
+    QMutex mutex;
+    QWaitCondition finishedCondition;
+    bool finished = false;
+};
+
+/*
+ * Requests that have been dropped but whose jobs may still be running.
+ * Jobs that use their owner's members keep running after cancel() until
+ * they next poll, so owners park dropped requests here and wait on them
+ * before going away.
+ */
+class RetiredRequests
+{
+public:
+    // Cancels the request and holds on to it until it finishes
+    void add(std::shared_ptr<AsyncRequest> request);
+    void waitForFinished();
+
+private:
+    std::vector<std::shared_ptr<AsyncRequest>> requests;
+};
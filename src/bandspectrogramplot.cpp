@@ -0,0 +1,333 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QPainter>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include "bandspectrogramplot.h"
+#include "kernels.h"
+#include "util.h"
+
+BandSpectrogramPlot::BandSpectrogramPlot(std::shared_ptr<TunerTransform> tuner)
+    : Plot(tuner), tuner(tuner), inputSource(tuner->input()),
+      levelCache(CacheBudget::FFTTiles), pixmapCache(CacheBudget::SpectrogramPixmaps)
+{
+    setHeight(fftSize);
+
+    for (int i = 0; i < 256; i++) {
+        float p = (float)i / 256;
+        colormap[i] = QColor::fromHsvF(p * 0.83f, 1.0, 1.0 - p).rgba();
+    }
+    updateColorTable();
+
+    auto hann = std::make_shared<std::vector<float>>(fftSize);
+    for (int i = 0; i < fftSize; i++)
+        (*hann)[i] = 0.5f * (1.0f - cos(Tau * i / fftSize));
+    window = hann;
+
+    updateBand();
+    connect(this, &BandSpectrogramPlot::tileReady, this, &BandSpectrogramPlot::handleTile);
+}
+
+BandSpectrogramPlot::~BandSpectrogramPlot()
+{
+    // Outstanding requests reference both us and the input
+    for (auto &request : tileRequests)
+        retired.add(request);
+    retired.waitForFinished();
+}
+
+void BandSpectrogramPlot::invalidateEvent()
+{
+    // The tuner moved, or the input changed underneath it
+    for (auto &request : tileRequests)
+        retired.add(request);
+    tileRequests.clear();
+    {
+        QMutexLocker ml(&levelCacheMutex);
+        generation++;
+        levelCache.clear();
+    }
+    pixmapCache.clear();
+    updateBand();
+    emit repaint();
+}
+
+void BandSpectrogramPlot::setPowerRange(int min, int max)
+{
+    if (powerMin == min && powerMax == max)
+        return;
+    powerMin = min;
+    powerMax = max;
+    updateColorTable();
+    emit repaint();
+}
+
+void BandSpectrogramPlot::updateColorTable()
+{
+    auto table = std::make_shared<ColorTable>();
+    table->generation = colorTable ? colorTable->generation + 1 : 0;
+    table->colors.resize(65536);
+    centiDbColorTable(powerMin, powerMax, colormap, table->colors.data());
+    std::atomic_store(&colorTable, std::shared_ptr<const ColorTable>(table));
+}
+
+void BandSpectrogramPlot::updateBand()
+{
+    auto params = tuner->currentParams();
+    auto newBand = std::make_shared<Band>();
+    newBand->frequency = params->frequency;
+
+    // Largest power of two whose decimated rate still holds the band
+    int decimation = 1;
+    int stages = 0;
+    while (decimation * 2 <= maxDecimation && params->bandwidth * decimation * 2 <= 1.0f) {
+        decimation *= 2;
+        stages++;
+    }
+    newBand->decimation = decimation;
+    newBand->stages = stages;
+    band = newBand;
+}
+
+void BandSpectrogramPlot::paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange)
+{
+    if (sampleRange.length() == 0) return;
+
+    size_t samplesPerColumn = std::max(1UL, sampleRange.length() / rect.width());
+    size_t samplesPerTile = tileWidth * samplesPerColumn;
+    size_t tile = sampleRange.minimum / samplesPerTile;
+    int xOffset = (sampleRange.minimum % samplesPerTile) / samplesPerColumn;
+    QSet<QString> visible;
+
+    for (int x = rect.left() - xOffset; x < rect.right(); x += tileWidth) {
+        painter.drawPixmap(
+            QRect(x, rect.y(), tileWidth, height()),
+            getTile(tile++, samplesPerColumn, visible)
+        );
+    }
+
+    // Anything that has scrolled out of view isn't worth finishing
+    for (auto it = tileRequests.begin(); it != tileRequests.end();) {
+        if (!visible.contains(it.key())) {
+            retired.add(it.value());
+            it = tileRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QString BandSpectrogramPlot::tileKey(size_t tile, size_t samplesPerColumn)
+{
+    QString key;
+    QTextStream(&key) << "bandspectrogram_" << generation << "_" << tile << "_" << samplesPerColumn;
+    return key;
+}
+
+QPixmap BandSpectrogramPlot::getTile(size_t tile, size_t samplesPerColumn, QSet<QString> &visible)
+{
+    QString key = tileKey(tile, samplesPerColumn);
+    ColoredTile colored;
+    bool found = pixmapCache.find(key, &colored);
+    if (found && colored.colorGeneration == colorTable->generation)
+        return colored.pixmap;
+
+    visible.insert(key);
+    if (!tileRequests.contains(key))
+        tileRequests.insert(key, requestTile(key, tile, samplesPerColumn));
+    if (found)
+        return colored.pixmap;
+    QPixmap pixmap(tileWidth, fftSize);
+    pixmap.fill(Qt::transparent);
+    return pixmap;
+}
+
+std::shared_ptr<AsyncRequest> BandSpectrogramPlot::requestTile(QString key, size_t tile, size_t samplesPerColumn)
+{
+    int generation = this->generation;
+    auto band = this->band;
+
+    return AsyncRequest::run([=](AsyncRequest &request) {
+        std::shared_ptr<const std::vector<int16_t>> levels;
+        if (!levelCache.find(key, &levels)) {
+            // Columns past either end of the input are left at -inf
+            auto computed = std::make_shared<std::vector<int16_t>>(tileWidth * fftSize, INT16_MIN);
+            computeLevels(computed->data(), tile, samplesPerColumn, *band, request);
+            if (request.isCancelled())
+                return;
+            {
+                // Checked and inserted under the lock so an invalidate
+                // can't be undone by levels computed for the old band
+                QMutexLocker ml(&levelCacheMutex);
+                if (generation != this->generation)
+                    return;
+                levelCache.insert(key, computed, computed->size() * sizeof(int16_t));
+            }
+            levels = computed;
+        }
+
+        // Highest frequency at the top, as in the main spectrogram
+        auto table = std::atomic_load(&colorTable);
+        QImage image(tileWidth, fftSize, QImage::Format_RGB32);
+        for (int y = 0; y < fftSize; y++) {
+            colorizeCentiDb(&(*levels)[fftSize - y - 1], fftSize, table->colors.data(),
+                            reinterpret_cast<QRgb*>(image.scanLine(y)), tileWidth);
+        }
+        emit tileReady(generation, key, table->generation, image);
+    }, AsyncRequest::Visible);
+}
+
+void BandSpectrogramPlot::computeLevels(int16_t *dest, size_t tile, size_t samplesPerColumn, const Band &band, AsyncRequest &request)
+{
+    // Each column is an FFT of the fftSize decimated samples centred on
+    // it, drawn only if all of those lie within the input
+    const size_t decimation = band.decimation;
+    const size_t halfSpan = fftSize / 2 * decimation;
+    const size_t count = inputSource->count();
+    auto columnCentre = [&](int x) {
+        return (tile * tileWidth + x) * samplesPerColumn + samplesPerColumn / 2;
+    };
+    auto inInput = [&](size_t centre) {
+        return centre >= halfSpan && centre + halfSpan <= count;
+    };
+    bool anyInInput = false;
+    for (int x = 0; x < tileWidth; x++)
+        anyInInput |= inInput(columnCentre(x));
+    if (!anyInInput)
+        return;
+
+    FFT fft(fftSize);
+    nco_crcf mix = nco_crcf_create(LIQUID_NCO);
+    std::vector<resamp2_crcf> stages;
+    for (int i = 0; i < band.stages; i++)
+        stages.push_back(resamp2_crcf_create(halfbandSemiLength, 0.0f, halfbandAttenuation));
+
+    if (samplesPerColumn < fftSize * decimation) {
+        // Neighbouring columns overlap, so decimate the tile's input once
+        // and cut each column's window out of the one stream
+        size_t first = columnCentre(0);
+        size_t outputs = (columnCentre(tileWidth - 1) - first) / decimation + fftSize + 1;
+        std::vector<std::complex<float>> decimated(outputs);
+        if (decimate(decimated.data(), (int64_t)first - (int64_t)halfSpan, outputs, band, mix, stages, request)) {
+            for (int x = 0; x < tileWidth; x++) {
+                size_t centre = columnCentre(x);
+                if (inInput(centre))
+                    columnPower(&dest[x * fftSize], &decimated[(centre - first + decimation / 2) / decimation], fft);
+            }
+        }
+    } else {
+        std::vector<std::complex<float>> decimated(fftSize);
+        for (int x = 0; x < tileWidth; x++) {
+            size_t centre = columnCentre(x);
+            if (!inInput(centre))
+                continue;
+            if (!decimate(decimated.data(), centre - halfSpan, fftSize, band, mix, stages, request))
+                break;
+            columnPower(&dest[x * fftSize], decimated.data(), fft);
+        }
+    }
+
+    for (auto stage : stages)
+        resamp2_crcf_destroy(stage);
+    nco_crcf_destroy(mix);
+}
+
+bool BandSpectrogramPlot::decimate(std::complex<float> *dest, int64_t start, size_t outputs, const Band &band,
+                                   nco_crcf mix, std::vector<resamp2_crcf> &stages, AsyncRequest &request)
+{
+    // A stage delays its input by 2m samples at its own rate, 2m(D-1)
+    // samples of input through the whole cascade, and has settled once
+    // 4m+1 have gone into it. Output i comes out as input (i+1)D-1 goes
+    // in, so starting this far back puts output warmup+j on start+jD
+    const int64_t decimation = band.decimation;
+    const int64_t delay = 2 * halfbandSemiLength * (decimation - 1);
+    const size_t warmup = stages.empty() ? 0 : 4 * halfbandSemiLength + 1;
+    const int64_t count = inputSource->count();
+    int64_t pos = start + delay + 1 - (int64_t)(warmup + 1) * decimation;
+
+    nco_crcf_set_phase(mix, fmod((double)band.frequency * pos, Tau));
+    nco_crcf_set_frequency(mix, band.frequency);
+    for (auto stage : stages)
+        resamp2_crcf_reset(stage);
+
+    // Blocks are whole multiples of the decimation, so every stage takes
+    // an even number of samples and can work in place
+    const size_t blockOutputs = std::max<int64_t>(1, decimationBlockSize / decimation);
+    std::vector<std::complex<float>> block(blockOutputs * decimation);
+    const size_t total = warmup + outputs;
+    for (size_t produced = 0; produced < total;) {
+        if (request.isCancelled())
+            return false;
+        size_t n = std::min(blockOutputs, total - produced);
+        size_t length = n * decimation;
+
+        // Zeros stand in for anything before or after the input
+        std::fill(block.begin(), block.begin() + length, std::complex<float>(0.0f, 0.0f));
+        int64_t from = std::max<int64_t>(pos, 0);
+        int64_t to = std::min<int64_t>(pos + (int64_t)length, count);
+        if (from < to) {
+            auto samples = inputSource->getSamples(from, to - from);
+            if (samples == nullptr)
+                return false;
+            std::copy(samples.get(), samples.get() + (to - from), &block[from - pos]);
+        }
+        nco_crcf_mix_block_down(mix, block.data(), block.data(), length);
+
+        for (auto stage : stages) {
+            length /= 2;
+            for (size_t i = 0; i < length; i++)
+                resamp2_crcf_decim_execute(stage, &block[2 * i], &block[i]);
+        }
+        for (size_t i = 0; i < n; i++, produced++) {
+            if (produced >= warmup)
+                dest[produced - warmup] = block[i];
+        }
+        pos += (int64_t)n * decimation;
+    }
+    return true;
+}
+
+void BandSpectrogramPlot::columnPower(int16_t *dest, const std::complex<float> *samples, FFT &fft)
+{
+    auto buffer = fft.buffer();
+    windowComplex(samples, window->data(), buffer, fftSize);
+    fft.execute();
+
+    // FFT-shift so the band runs from its lowest frequency upwards
+    const float dbOffset = -20.0f * log10f(fftSize);
+    float power[fftSize];
+    powerComplexDb(buffer + fftSize / 2, dbOffset, power, fftSize / 2);
+    powerComplexDb(buffer, dbOffset, power + fftSize / 2, fftSize / 2);
+    encodeCentiDb(power, dest, fftSize);
+}
+
+void BandSpectrogramPlot::handleTile(int generation, QString key, int colorGeneration, QImage image)
+{
+    if (generation != this->generation)
+        return;
+    // A tile coloured before the latest range change is still better
+    // than nothing; the next paint asks for it again
+    tileRequests.remove(key);
+    ColoredTile tile{QPixmap::fromImage(image), colorGeneration};
+    pixmapCache.insert(key, tile, qint64(image.bytesPerLine()) * image.height());
+    emit repaint();
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <complex>
+#include <memory>
+#include <vector>
+#include "asyncrequest.h"
+#include "fft.h"
+#include "memorycache.h"
+#include "plot.h"
+#include "samplesource.h"
+#include "tunertransform.h"
+
+/*
+ * Spectrogram of just the band selected by the tuner.
+ *
+ * Instead of running enormous FFTs over the whole capture, each column
+ * mixes the band down to baseband, decimates it by the largest power of
+ * two that still covers the tuner bandwidth, then takes a small FFT of
+ * the result. The rows of the plot therefore span the band alone, at a
+ * resolution the full spectrogram would need a much bigger FFT for.
+ *
+ * Decimation is a cascade of halfband stages, so its cost per input
+ * sample stays small however far the band is zoomed in.
+ */
+class BandSpectrogramPlot : public Plot
+{
+    Q_OBJECT
+
+public:
+    BandSpectrogramPlot(std::shared_ptr<TunerTransform> tuner);
+    ~BandSpectrogramPlot();
+
+    void invalidateEvent() override;
+    void paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange) override;
+    void setPowerRange(int min, int max);
+
+signals:
+    void tileReady(int generation, QString key, int colorGeneration, QImage image);
+
+public slots:
+    void handleTile(int generation, QString key, int colorGeneration, QImage image);
+
+private:
+    // Everything a tile job needs, fixed when it is queued
+    struct Band
+    {
+        float frequency;
+        int decimation;
+        // Halfband stages, each decimating by two
+        int stages;
+    };
+
+    // One colour per centi-dB value (see centiDbColorTable)
+    struct ColorTable
+    {
+        int generation;
+        std::vector<QRgb> colors;
+    };
+
+    struct ColoredTile
+    {
+        QPixmap pixmap;
+        int colorGeneration;
+    };
+
+    static const int fftSize = 256;
+    static const int tileWidth = 256;
+    static const int maxDecimation = 4096;
+    // Semi-length of each halfband filter, and its stopband attenuation
+    static const int halfbandSemiLength = 8;
+    static constexpr float halfbandAttenuation = 60.0f;
+    // Input samples mixed and decimated at a time
+    static const int decimationBlockSize = 65536;
+
+    std::shared_ptr<TunerTransform> tuner;
+    std::shared_ptr<SampleSource<std::complex<float>>> inputSource;
+    std::shared_ptr<const Band> band;
+    std::shared_ptr<const std::vector<float>> window;
+    // Written under levelCacheMutex, as jobs check it before inserting
+    int generation = 0;
+    float powerMin = -50.0f;
+    float powerMax = 0.0f;
+    uint colormap[256];
+    // Swapped atomically, as jobs pick up the latest table when they
+    // colour a tile rather than the one current when they were queued
+    std::shared_ptr<const ColorTable> colorTable;
+
+    // Columns are kept as centi-dB, so a new power range only means
+    // recolouring them. Pixmaps in older colours are drawn until then
+    MemoryCache<QString, std::shared_ptr<const std::vector<int16_t>>> levelCache;
+    // Held while checking the generation and inserting, and while clearing
+    QMutex levelCacheMutex;
+    MemoryCache<QString, ColoredTile> pixmapCache;
+    QHash<QString, std::shared_ptr<AsyncRequest>> tileRequests;
+    // Dropped requests that may still be running against us
+    RetiredRequests retired;
+
+    void updateBand();
+    void updateColorTable();
+    QString tileKey(size_t tile, size_t samplesPerColumn);
+    QPixmap getTile(size_t tile, size_t samplesPerColumn, QSet<QString> &visible);
+    std::shared_ptr<AsyncRequest> requestTile(QString key, size_t tile, size_t samplesPerColumn);
+    void computeLevels(int16_t *dest, size_t tile, size_t samplesPerColumn, const Band &band, AsyncRequest &request);
+    bool decimate(std::complex<float> *dest, int64_t start, size_t outputs, const Band &band,
+                  nco_crcf mix, std::vector<resamp2_crcf> &stages, AsyncRequest &request);
+    void columnPower(int16_t *dest, const std::complex<float> *samples, FFT &fft);
+};
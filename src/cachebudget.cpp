@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QMutexLocker>
+#include <QSettings>
+#include <algorithm>
+#include "cachebudget.h"
+
+// Share of the budget for each category, in Category order
+static const double categoryShare[CacheBudget::CategoryCount] = { 0.3, 0.5, 0.2 };
+static const char *categoryName[CacheBudget::CategoryCount] = {
+    "Spectrogram",
+    "FFT tiles",
+    "Traces",
+};
+
+CacheBudget& CacheBudget::instance()
+{
+    static CacheBudget budget;
+    return budget;
+}
+
+CacheBudget::CacheBudget()
+{
+    QSettings settings;
+    totalBytes = settings.value("CacheMemoryMB", 1024).toLongLong() << 20;
+}
+
+void CacheBudget::setTotal(qint64 bytes)
+{
+    QMutexLocker ml(&mutex);
+    totalBytes = bytes;
+    for (int category = 0; category < CategoryCount; category++)
+        distribute(static_cast<Category>(category));
+}
+
+qint64 CacheBudget::total()
+{
+    QMutexLocker ml(&mutex);
+    return totalBytes;
+}
+
+QVector<CacheBudget::Usage> CacheBudget::usage()
+{
+    QMutexLocker ml(&mutex);
+    QVector<Usage> result;
+    for (int category = 0; category < CategoryCount; category++) {
+        Usage usage;
+        usage.name = categoryName[category];
+        for (auto cache : caches[category]) {
+            auto stats = cache->stats();
+            usage.stats.bytes += stats.bytes;
+            usage.stats.limit += stats.limit;
+            usage.stats.hits += stats.hits;
+            usage.stats.misses += stats.misses;
+            usage.stats.evictions += stats.evictions;
+        }
+        result.append(usage);
+    }
+    return result;
+}
+
+void CacheBudget::add(Category category, BudgetedCache *cache)
+{
+    QMutexLocker ml(&mutex);
+    caches[category].push_back(cache);
+    distribute(category);
+}
+
+void CacheBudget::remove(Category category, BudgetedCache *cache)
+{
+    QMutexLocker ml(&mutex);
+    auto &list = caches[category];
+    list.erase(std::remove(list.begin(), list.end(), cache), list.end());
+    distribute(category);
+}
+
+void CacheBudget::distribute(Category category)
+{
+    auto &list = caches[category];
+    if (list.empty())
+        return;
+    qint64 share = totalBytes * categoryShare[category] / list.size();
+    for (auto cache : list)
+        cache->setLimit(share);
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+struct CacheStats {
+    qint64 bytes = 0;
+    qint64 limit = 0;
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+};
+
+class BudgetedCache
+{
+public:
+    virtual ~BudgetedCache() { };
+    virtual void setLimit(qint64 bytes) = 0;
+    virtual CacheStats stats() = 0;
+};
+
+/*
+ * Splits one memory budget between every in-memory cache of rendered
+ * or computed tiles, so the total can be sized to the machine.
+ *
+ * Each category gets a fixed share of the budget, divided evenly
+ * between the caches currently registered in it.
+ */
+class CacheBudget
+{
+public:
+    enum Category {
+        SpectrogramPixmaps,
+        FFTTiles,
+        TracePixmaps,
+        CategoryCount
+    };
+
+    struct Usage {
+        QString name;
+        CacheStats stats;
+    };
+
+    static CacheBudget& instance();
+
+    void setTotal(qint64 bytes);
+    qint64 total();
+    // Totals for each category, summed over its caches
+    QVector<Usage> usage();
+
+    void add(Category category, BudgetedCache *cache);
+    void remove(Category category, BudgetedCache *cache);
+
+private:
+    CacheBudget();
+    CacheBudget(const CacheBudget &) = delete;
+    CacheBudget& operator=(const CacheBudget &) = delete;
+
+    void distribute(Category category);
+
+    QMutex mutex;
+    qint64 totalBytes;
+    std::vector<BudgetedCache*> caches[CategoryCount];
+};
@@ -18,27 +18,28 @@
  */
 
 #include "fft.h"
-#include "string.h"
+#include "fftplanmanager.h"
 
-FFT::FFT(int size)
+FFT::FFT(int size, int batch, bool real)
 {
     fftSize = size;
+    batchSize = batch;
+    realInput = real;
 
-    fftwIn = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwOut = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwPlan = fftwf_plan_dft_1d(fftSize, fftwIn, fftwOut, FFTW_FORWARD, FFTW_MEASURE);
+    fftwBuffer = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * outputSize() * batchSize);
 }
 
 FFT::~FFT()
 {
-    if (fftwPlan) fftwf_destroy_plan(fftwPlan);
-    if (fftwIn) fftwf_free(fftwIn);
-    if (fftwOut) fftwf_free(fftwOut);
+    if (fftwBuffer) fftwf_free(fftwBuffer);
 }
 
-void FFT::process(void *dest, void *source)
+void FFT::execute()
 {
-    memcpy(fftwIn, source, fftSize * sizeof(fftwf_complex));
-    fftwf_execute(fftwPlan);
-    memcpy(dest, fftwOut, fftSize * sizeof(fftwf_complex));
+    // Looked up each time so a measured plan is picked up once it's ready
+    auto plan = FFTPlanManager::instance().plan(fftSize, batchSize, realInput);
+    if (realInput)
+        fftwf_execute_dft_r2c(plan, realBuffer(), fftwBuffer);
+    else
+        fftwf_execute_dft(plan, fftwBuffer, fftwBuffer);
 }
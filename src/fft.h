@@ -19,21 +19,49 @@
 
 #pragma once
 
+#include <complex>
 #include <fftw3.h>
 
+/*
+ * A batch of same-sized forward transforms run in place over one
+ * contiguous, FFTW-aligned buffer: the output of transform i starts at
+ * buffer()[i * outputSize()].
+ *
+ * Complex transforms also take their input from there. Real transforms
+ * take theirs from realBuffer()[i * realStride()] and produce only the
+ * size / 2 + 1 non-negative frequency bins.
+ */
 class FFT
 {
 public:
-    FFT(int size);
+    FFT(int size, int batch = 1, bool real = false);
     ~FFT();
-    void process(void *dest, void *source);
+    std::complex<float>* buffer() {
+        return reinterpret_cast<std::complex<float>*>(fftwBuffer);
+    }
+    float* realBuffer() {
+        return reinterpret_cast<float*>(fftwBuffer);
+    }
+    void execute();
     int getSize() {
         return fftSize;
     }
+    int getBatch() {
+        return batchSize;
+    }
+    bool isReal() {
+        return realInput;
+    }
+    int outputSize() {
+        return realInput ? fftSize / 2 + 1 : fftSize;
+    }
+    int realStride() {
+        return 2 * (fftSize / 2 + 1);
+    }
 
 private:
     int fftSize;
-    fftwf_complex *fftwIn = nullptr;
-    fftwf_complex *fftwOut = nullptr;
-    fftwf_plan fftwPlan = nullptr;
+    int batchSize;
+    bool realInput;
+    fftwf_complex *fftwBuffer = nullptr;
 };
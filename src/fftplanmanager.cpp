@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include "asyncrequest.h"
+#include "fftplanmanager.h"
+
+// Upper bound on the time spent measuring any one plan in the background
+static const double measureTimeLimit = 1.0;
+
+// Transforms at least this big are split across FFTW's own threads
+static const int threadedSize = 1 << 16;
+
+FFTPlanManager& FFTPlanManager::instance()
+{
+    static FFTPlanManager manager;
+    return manager;
+}
+
+FFTPlanManager::FFTPlanManager()
+{
+#ifdef HAVE_FFTW_THREADS
+    fftwf_init_threads();
+#endif
+
+    auto configDir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
+    if (!configDir.isEmpty() && QDir().mkpath(configDir)) {
+        wisdomFilename = configDir + "/fftw-wisdom";
+        fftwf_import_wisdom_from_filename(QFile::encodeName(wisdomFilename).constData());
+    }
+    fftwf_set_timelimit(measureTimeLimit);
+}
+
+quint64 FFTPlanManager::planKey(int size, int batch, bool real)
+{
+    return (quint64(size) << 32) | (quint64(batch) << 1) | (real ? 1 : 0);
+}
+
+fftwf_plan FFTPlanManager::plan(int size, int batch, bool real)
+{
+    auto key = planKey(size, batch, real);
+    {
+        QMutexLocker ml(&plansMutex);
+        auto it = plans.find(key);
+        if (it != plans.end())
+            return it.value();
+    }
+
+    QMutexLocker pl(&plannerMutex);
+    {
+        // Someone else may have planned it while we waited
+        QMutexLocker ml(&plansMutex);
+        auto it = plans.find(key);
+        if (it != plans.end())
+            return it.value();
+    }
+
+    auto p = createPlan(size, batch, real, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+    bool measured = (p != nullptr);
+    if (!measured)
+        p = createPlan(size, batch, real, FFTW_ESTIMATE);
+
+    {
+        QMutexLocker ml(&plansMutex);
+        plans.insert(key, p);
+    }
+    pl.unlock();
+
+    if (!measured) {
+        AsyncRequest::run([=](AsyncRequest &) {
+            measure(size, batch, real);
+        }, AsyncRequest::Prefetch);
+    }
+    return p;
+}
+
+fftwf_plan FFTPlanManager::createPlan(int size, int batch, bool real, unsigned flags)
+{
+    int outputSize = real ? size / 2 + 1 : size;
+    auto scratch = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * outputSize * batch);
+
+#ifdef HAVE_FFTW_THREADS
+    fftwf_plan_with_nthreads(size >= threadedSize ? QThread::idealThreadCount() : 1);
+#endif
+
+    fftwf_plan p;
+    if (real) {
+        p = fftwf_plan_many_dft_r2c(1, &size, batch,
+                                    reinterpret_cast<float*>(scratch), nullptr, 1, 2 * outputSize,
+                                    scratch, nullptr, 1, outputSize,
+                                    flags);
+    } else {
+        p = fftwf_plan_many_dft(1, &size, batch,
+                                scratch, nullptr, 1, size,
+                                scratch, nullptr, 1, size,
+                                FFTW_FORWARD, flags);
+    }
+
+    fftwf_free(scratch);
+    return p;
+}
+
+void FFTPlanManager::measure(int size, int batch, bool real)
+{
+    QMutexLocker pl(&plannerMutex);
+    auto p = createPlan(size, batch, real, FFTW_MEASURE);
+    if (p == nullptr)
+        return;
+
+    // The estimated plan this replaces may still be executing on another
+    // thread, so it is deliberately never destroyed
+    {
+        QMutexLocker ml(&plansMutex);
+        plans.insert(planKey(size, batch, real), p);
+    }
+
+    if (!wisdomFilename.isEmpty())
+        fftwf_export_wisdom_to_filename(QFile::encodeName(wisdomFilename).constData());
+}
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <fftw3.h>
+
+/*
+ * Process-wide cache of FFTW plans for in-place batched transforms.
+ *
+ * Plans are looked up in the saved wisdom first. Failing that an
+ * FFTW_ESTIMATE plan is returned straight away and an FFTW_MEASURE plan
+ * is made on the thread pool to replace it. Measured plans are added to
+ * the wisdom file in the user's config directory, so later runs get them
+ * immediately.
+ *
+ * Plans are made on scratch buffers and must be run with the new-array
+ * execute functions on FFTW-aligned (fftwf_malloc) buffers.
+ */
+class FFTPlanManager
+{
+public:
+    static FFTPlanManager& instance();
+    fftwf_plan plan(int size, int batch, bool real);
+
+private:
+    FFTPlanManager();
+    FFTPlanManager(const FFTPlanManager &) = delete;
+    FFTPlanManager& operator=(const FFTPlanManager &) = delete;
+
+    static quint64 planKey(int size, int batch, bool real);
+    fftwf_plan createPlan(int size, int batch, bool real, unsigned flags);
+    void measure(int size, int batch, bool real);
+
+    // Guards plans
+    QMutex plansMutex;
+    // FFTW's planner isn't thread-safe, so every planner call holds this
+    QMutex plannerMutex;
+    QHash<quint64, fftwf_plan> plans;
+    QString wisdomFilename;
+};
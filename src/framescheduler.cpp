@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "framescheduler.h"
+
+FrameScheduler& FrameScheduler::instance()
+{
+    static FrameScheduler scheduler;
+    return scheduler;
+}
+
+FrameScheduler::FrameScheduler()
+{
+    frameTimer.setSingleShot(true);
+    frameTimer.setInterval(frameIntervalMs);
+    connect(&frameTimer, &QTimer::timeout, this, &FrameScheduler::frame);
+}
+
+void FrameScheduler::beginFrame()
+{
+    frameClock.start();
+    deferred = false;
+}
+
+void FrameScheduler::endFrame()
+{
+    frameClock.invalidate();
+    if (deferred)
+        requestFrame();
+}
+
+bool FrameScheduler::hasBudget() const
+{
+    return !frameClock.isValid() || frameClock.elapsed() < frameBudgetMs;
+}
+
+void FrameScheduler::defer()
+{
+    deferred = true;
+}
+
+void FrameScheduler::requestFrame()
+{
+    // Already due, so this one rides along
+    if (!frameTimer.isActive())
+        frameTimer.start();
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+/*
+ * Paces repaints of the plots and bounds the GUI thread's work in each.
+ *
+ * Plots compose frames only from what is ready and hand anything
+ * missing to the thread pool. The little work left on the GUI thread
+ * that can be put off (drawing stand-in tiles, say) checks hasBudget()
+ * first and calls defer() if it skips, which schedules another frame.
+ * Results coming back from the pool ask for a frame rather than
+ * repainting straight away, so a burst of them costs one repaint per
+ * frame interval. GUI thread only.
+ */
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static FrameScheduler& instance();
+
+    void beginFrame();
+    void endFrame();
+    // True while the frame being painted still has time left
+    bool hasBudget() const;
+    void defer();
+    void requestFrame();
+
+signals:
+    void frame();
+
+private:
+    FrameScheduler();
+    FrameScheduler(const FrameScheduler &) = delete;
+    FrameScheduler& operator=(const FrameScheduler &) = delete;
+
+    static const int frameIntervalMs = 16;
+    static const int frameBudgetMs = 8;
+
+    QTimer frameTimer;
+    QElapsedTimer frameClock;
+    bool deferred = false;
+};
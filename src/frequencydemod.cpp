@@ -18,10 +18,9 @@
  */
 
 #include "frequencydemod.h"
-#include <liquid/liquid.h>
 #include "util.h"
-#include <QSettings>
 
+StageParams<FrequencyDemodParams> FrequencyDemod::params;
 
 FrequencyDemod::FrequencyDemod(std::shared_ptr<SampleSource<std::complex<float>>> src) : SampleBuffer(src)
 {
@@ -38,11 +37,24 @@ void FrequencyDemod::work(void *input, void *output, int count, size_t sampleid)
 
     auto in = static_cast<std::complex<float>*>(input);
     auto out = static_cast<float*>(output);
-    freqdem fdem = freqdem_create(relativeBandwidth() / 2.0);
 
-    QSettings settings;
-    int sqval = settings.value("Squelch", 0).toInt();
-    double squelch_threshold = pow(2, sqval+2); // 100.0 * settings.value("Squelch", 0).toInt();
+    // Only rebuild the demodulator when the bandwidth actually moves,
+    // otherwise just reset it as blocks aren't contiguous
+    auto state = states.acquire();
+    float bandwidth = relativeBandwidth();
+    if (state->fdem == nullptr || bandwidth != state->bandwidth) {
+        if (state->fdem != nullptr)
+            freqdem_destroy(state->fdem);
+        state->fdem = freqdem_create(bandwidth / 2.0);
+        state->bandwidth = bandwidth;
+    } else {
+        freqdem_reset(state->fdem);
+    }
+    freqdem fdem = state->fdem;
+
+    params.update(state->paramsGeneration, state->params);
+    int sqval = state->params->squelch;
+    double squelch_threshold = pow(2, sqval+2);
     bool using_squelch = sqval ? true : false;
 
     if (using_squelch) {
@@ -74,5 +86,4 @@ void FrequencyDemod::work(void *input, void *output, int count, size_t sampleid)
         	 out[i] = 0;
          }
     }
-    freqdem_destroy(fdem);
 }
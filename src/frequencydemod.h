@@ -19,11 +19,42 @@
 
 #pragma once
 
+#include <liquid/liquid.h>
 #include "samplebuffer.h"
+#include "stageparams.h"
+#include "statepool.h"
+
+struct FrequencyDemodParams
+{
+    int squelch = 0;
+
+    bool operator==(const FrequencyDemodParams &other) const {
+        return squelch == other.squelch;
+    }
+};
 
 class FrequencyDemod : public SampleBuffer<std::complex<float>, float>
 {
 public:
     FrequencyDemod(std::shared_ptr<SampleSource<std::complex<float>>> src);
     void work(void *input, void *output, int count, size_t sampleid) override;
+
+    // Shared by every frequency demod, pushed from the squelch control
+    static StageParams<FrequencyDemodParams> params;
+
+private:
+    struct State
+    {
+        ~State() {
+            if (fdem != nullptr)
+                freqdem_destroy(fdem);
+        }
+
+        freqdem fdem = nullptr;
+        float bandwidth = 0.0f;
+        uint64_t paramsGeneration = 0;
+        std::shared_ptr<const FrequencyDemodParams> params;
+    };
+
+    StatePool<State> states;
 };
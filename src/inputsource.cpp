@@ -27,6 +27,7 @@
 #include <stdexcept>
 #include <algorithm>
 
+#include <QDateTime>
 #include <QFileInfo>
 
 #include <QElapsedTimer>
@@ -50,6 +51,11 @@ public:
         auto s = reinterpret_cast<const std::complex<float>*>(src);
         std::copy(&s[start], &s[start + length], dest);
     }
+
+    void copyRangeWindowed(const void* const src, size_t start, size_t length, const float *window, std::complex<float>* const dest) override {
+        auto s = reinterpret_cast<const std::complex<float>*>(src);
+        windowComplex(&s[start], window, dest, length);
+    }
 };
 
 class ComplexF64SampleAdapter : public SampleAdapter {
@@ -100,6 +106,17 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const std::complex<int16_t>*>(src);
+        std::copy(&s[start], &s[start + length], dest);
+        return true;
+    }
+
+    void copyRangeWindowed(const void* const src, size_t start, size_t length, const float *window, std::complex<float>* const dest) override {
+        auto s = reinterpret_cast<const std::complex<int16_t>*>(src);
+        windowComplexInt16(&s[start], window, 1.0f / 32768.0f, dest, length);
+    }
 };
 
 class ComplexS8SampleAdapter : public SampleAdapter {
@@ -117,6 +134,16 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const std::complex<int8_t>*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const std::complex<int8_t>& v) -> std::complex<int16_t> {
+                return { static_cast<int16_t>(v.real() * 256), static_cast<int16_t>(v.imag() * 256) };
+            }
+        );
+        return true;
+    }
 };
 
 class ComplexU8SampleAdapter : public SampleAdapter {
@@ -134,6 +161,18 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const std::complex<uint8_t>*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const std::complex<uint8_t>& v) -> std::complex<int16_t> {
+                // 127.4 * 256, matching the float conversion above
+                const int offset = 32614;
+                return { static_cast<int16_t>(v.real() * 256 - offset), static_cast<int16_t>(v.imag() * 256 - offset) };
+            }
+        );
+        return true;
+    }
 };
 
 class RealF32SampleAdapter : public SampleAdapter {
@@ -150,6 +189,18 @@ public:
             }
         );
     }
+
+    bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) override {
+        auto s = reinterpret_cast<const float*>(src);
+        std::copy(&s[start], &s[start + length], dest);
+        return true;
+    }
+
+    bool copyRangeRealWindowed(const void* const src, size_t start, size_t length, const float *window, float* const dest) override {
+        auto s = reinterpret_cast<const float*>(src);
+        windowReal(&s[start], window, dest, length);
+        return true;
+    }
 };
 
 class RealF64SampleAdapter : public SampleAdapter {
@@ -166,6 +217,16 @@ public:
             }
         );
     }
+
+    bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) override {
+        auto s = reinterpret_cast<const double*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const double& v) -> float {
+                return static_cast<float>(v);
+            }
+        );
+        return true;
+    }
 };
 
 class RealS16SampleAdapter : public SampleAdapter {
@@ -183,6 +244,27 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const int16_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const int16_t& v) -> std::complex<int16_t> {
+                return { v, 0 };
+            }
+        );
+        return true;
+    }
+
+    bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) override {
+        auto s = reinterpret_cast<const int16_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const int16_t& v) -> float {
+                const float k = 1.0f / 32768.0f;
+                return v * k;
+            }
+        );
+        return true;
+    }
 };
 
 class RealS8SampleAdapter : public SampleAdapter {
@@ -200,6 +282,27 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const int8_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const int8_t& v) -> std::complex<int16_t> {
+                return { static_cast<int16_t>(v * 256), 0 };
+            }
+        );
+        return true;
+    }
+
+    bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) override {
+        auto s = reinterpret_cast<const int8_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const int8_t& v) -> float {
+                const float k = 1.0f / 128.0f;
+                return v * k;
+            }
+        );
+        return true;
+    }
 };
 
 class RealU8SampleAdapter : public SampleAdapter {
@@ -217,6 +320,28 @@ public:
             }
         );
     }
+
+    bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) override {
+        auto s = reinterpret_cast<const uint8_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const uint8_t& v) -> std::complex<int16_t> {
+                const int offset = 32614;
+                return { static_cast<int16_t>(v * 256 - offset), 0 };
+            }
+        );
+        return true;
+    }
+
+    bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) override {
+        auto s = reinterpret_cast<const uint8_t*>(src);
+        std::transform(&s[start], &s[start + length], dest,
+            [](const uint8_t& v) -> float {
+                const float k = 1.0f / 128.0f;
+                return (v - 127.4f) * k;
+            }
+        );
+        return true;
+    }
 };
 
 InputSource::InputSource()
@@ -230,6 +355,7 @@ InputSource::~InputSource()
 
 void InputSource::cleanup()
 {
+    QWriteLocker wl(&mmapLock);
     if (mmapData != nullptr) {
         inputFile->unmap(mmapData);
         mmapData = nullptr;
@@ -356,9 +482,11 @@ QJsonObject InputSource::readMetaData(const QString &filename)
 
 void InputSource::openFile(const char *filename)
 {
+    QWriteLocker wl(&mmapLock);
     QFileInfo fileInfo(filename);
     std::string suffix = std::string(fileInfo.suffix().toLower().toUtf8().constData());
     if (_fmt != "") { suffix = _fmt; } // allow fmt override
+    sampleFormat = suffix;
     if ((suffix == "cfile") || (suffix == "cf32")  || (suffix == "fc32")) {
         sampleAdapter = std::make_unique<ComplexF32SampleAdapter>();
     }
@@ -448,6 +576,7 @@ void InputSource::openFile(const char *filename)
     inputFile = file.release();
     mmapData = data;
 
+    wl.unlock();
     invalidate();
 }
 
@@ -472,8 +601,31 @@ double InputSource::centerFrequency()
 {
     return centerFreq;
 }
+QString InputSource::fileName()
+{
+    QReadLocker rl(&mmapLock);
+    if (inputFile == nullptr)
+        return QString();
+    return QFileInfo(inputFile->fileName()).absoluteFilePath();
+}
+
+QString InputSource::identity()
+{
+    QReadLocker rl(&mmapLock);
+    if (inputFile == nullptr)
+        return QString();
+
+    QFileInfo fileInfo(inputFile->fileName());
+    return QString("%1|%2|%3|%4")
+        .arg(fileInfo.absoluteFilePath())
+        .arg(fileInfo.size())
+        .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+        .arg(QString::fromStdString(sampleFormat));
+}
+
 std::unique_ptr<std::complex<float>[]> InputSource::getSamples(size_t start, size_t length)
 {
+    QReadLocker rl(&mmapLock);
     if (inputFile == nullptr)
         return nullptr;
 
@@ -492,6 +644,70 @@ std::unique_ptr<std::complex<float>[]> InputSource::getSamples(size_t start, siz
     return dest;
 }
 
+std::unique_ptr<std::complex<int16_t>[]> InputSource::getSamplesInt16(size_t start, size_t length)
+{
+    QReadLocker rl(&mmapLock);
+    if (inputFile == nullptr)
+        return nullptr;
+
+    if (mmapData == nullptr)
+        return nullptr;
+
+    if (start + length > sampleCount)
+        return nullptr;
+
+    auto dest = std::make_unique<std::complex<int16_t>[]>(length);
+    if (!sampleAdapter->copyRangeInt16(mmapData, start, length, dest.get()))
+        return nullptr;
+
+    return dest;
+}
+
+std::unique_ptr<float[]> InputSource::getSamplesReal(size_t start, size_t length)
+{
+    QReadLocker rl(&mmapLock);
+
+    if (inputFile == nullptr)
+        return nullptr;
+
+    if (mmapData == nullptr)
+        return nullptr;
+
+    if (start + length > sampleCount)
+        return nullptr;
+
+    auto dest = std::make_unique<float[]>(length);
+    if (!sampleAdapter->copyRangeReal(mmapData, start, length, dest.get()))
+        return nullptr;
+
+    return dest;
+}
+
+bool InputSource::getWindowedSamples(size_t start, size_t length, const float *window, std::complex<float> *dest)
+{
+    QReadLocker rl(&mmapLock);
+    if (inputFile == nullptr || mmapData == nullptr)
+        return false;
+
+    if (start + length > sampleCount)
+        return false;
+
+    sampleAdapter->copyRangeWindowed(mmapData, start, length, window, dest);
+    return true;
+}
+
+bool InputSource::getWindowedSamplesReal(size_t start, size_t length, const float *window, float *dest)
+{
+    QReadLocker rl(&mmapLock);
+    if (inputFile == nullptr || mmapData == nullptr)
+        return false;
+
+    if (start + length > sampleCount)
+        return false;
+
+    return sampleAdapter->copyRangeRealWindowed(mmapData, start, length, window, dest);
+}
+
 void InputSource::setFormat(std::string fmt){
     _fmt = fmt;
 }
@@ -22,12 +22,35 @@
 
 #include <complex>
 #include <QFile>
+#include <QReadWriteLock>
+#include "kernels.h"
 #include "samplesource.h"
 
 class SampleAdapter {
 public:
     virtual size_t sampleSize() = 0;
     virtual void copyRange(const void* const src, size_t start, size_t length, std::complex<float>* const dest) = 0;
+    // Integer formats can also be copied as Q15 without going through float
+    virtual bool copyRangeInt16(const void* const src, size_t start, size_t length, std::complex<int16_t>* const dest) {
+        return false;
+    };
+    // Real formats can also be copied without a zero imaginary part
+    virtual bool copyRangeReal(const void* const src, size_t start, size_t length, float* const dest) {
+        return false;
+    };
+    // Copies multiplied by window[], for the FFT input. By default this
+    // converts first and windows in place; formats the kernels can read
+    // directly do both in one pass
+    virtual void copyRangeWindowed(const void* const src, size_t start, size_t length, const float *window, std::complex<float>* const dest) {
+        copyRange(src, start, length, dest);
+        windowComplex(dest, window, dest, length);
+    };
+    virtual bool copyRangeRealWindowed(const void* const src, size_t start, size_t length, const float *window, float* const dest) {
+        if (!copyRangeReal(src, start, length, dest))
+            return false;
+        windowReal(dest, window, dest, length);
+        return true;
+    };
     virtual ~SampleAdapter() { };
 };
 
@@ -39,8 +62,12 @@ private:
     double sampleRate = 0.0;
     double centerFreq = 0.0;
     uchar *mmapData = nullptr;
+    // Held for reading while copying out of the mapping from worker
+    // threads, and for writing while openFile() swaps the file out
+    QReadWriteLock mmapLock{QReadWriteLock::Recursive};
     std::unique_ptr<SampleAdapter> sampleAdapter;
     std::string _fmt;
+    std::string sampleFormat;
     bool _realSignal = false;
 
     QJsonObject readMetaData(const QString &filename);
@@ -51,6 +78,13 @@ public:
     void cleanup();
     void openFile(const char *filename);
     std::unique_ptr<std::complex<float>[]> getSamples(size_t start, size_t length);
+    // Samples scaled so 32768 is full scale, or nullptr if the format isn't integer
+    std::unique_ptr<std::complex<int16_t>[]> getSamplesInt16(size_t start, size_t length);
+    // Samples of a real signal as float, or nullptr if the format is complex
+    std::unique_ptr<float[]> getSamplesReal(size_t start, size_t length);
+    // Windowed samples written straight into dest (e.g. an FFT buffer)
+    bool getWindowedSamples(size_t start, size_t length, const float *window, std::complex<float> *dest);
+    bool getWindowedSamplesReal(size_t start, size_t length, const float *window, float *dest);
     size_t count() {
         return sampleCount;
     };
@@ -65,4 +99,6 @@ public:
     float relativeBandwidth() {
         return 1;
     }
+    QString fileName() override;
+    QString identity() override;
 };
@@ -0,0 +1,271 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "kernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void windowComplexInt16(const std::complex<int16_t> *in, const float *window, float scale,
+                        std::complex<float> *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(scale);
+    for (; i + 4 <= count; i += 4) {
+        // 4 complex samples, sign extended to 32 bits by unpacking
+        // against themselves and shifting back down
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        __m128 w = _mm_mul_ps(_mm_loadu_ps(window + i), k);
+        _mm_storeu_ps(reinterpret_cast<float*>(out + i), _mm_mul_ps(lo, _mm_unpacklo_ps(w, w)));
+        _mm_storeu_ps(reinterpret_cast<float*>(out + i + 2), _mm_mul_ps(hi, _mm_unpackhi_ps(w, w)));
+    }
+#endif
+    for (; i < count; i++) {
+        float w = window[i] * scale;
+        out[i] = { in[i].real() * w, in[i].imag() * w };
+    }
+}
+
+void windowComplex(const std::complex<float> *in, const float *window,
+                   std::complex<float> *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    auto src = reinterpret_cast<const float*>(in);
+    auto dst = reinterpret_cast<float*>(out);
+    for (; i + 4 <= count; i += 4) {
+        __m128 w = _mm_loadu_ps(window + i);
+        _mm_storeu_ps(dst + i * 2, _mm_mul_ps(_mm_loadu_ps(src + i * 2), _mm_unpacklo_ps(w, w)));
+        _mm_storeu_ps(dst + i * 2 + 4, _mm_mul_ps(_mm_loadu_ps(src + i * 2 + 4), _mm_unpackhi_ps(w, w)));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = in[i] * window[i];
+}
+
+void windowReal(const float *in, const float *window, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), _mm_loadu_ps(window + i)));
+#endif
+    for (; i < count; i++)
+        out[i] = in[i] * window[i];
+}
+
+// log2(1 + m) for m in [0, 1), least squares fit
+static const float log2Poly[4] = { 1.43854679f, -0.678081486f, 0.323630368f, -0.0842850926f };
+static const float dbPerOctave = 10.0f * 0.30102999566f;
+
+static inline float fastDb(float power, float offset)
+{
+    if (power == 0.0f)
+        return -std::numeric_limits<float>::infinity();
+    uint32_t bits;
+    memcpy(&bits, &power, sizeof(bits));
+    float exponent = int((bits >> 23) & 0xff) - 127;
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    m -= 1.0f;
+    float log2 = exponent + m * (log2Poly[0] + m * (log2Poly[1] + m * (log2Poly[2] + m * log2Poly[3])));
+    return log2 * dbPerOctave + offset;
+}
+
+#if defined(__SSE2__)
+static inline __m128 fastDb(__m128 power, __m128 offset)
+{
+    const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+    const __m128i one = _mm_set1_epi32(0x3f800000);
+    __m128i bits = _mm_castps_si128(power);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 m = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one)), _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(log2Poly[3]);
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(log2Poly[2]));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(log2Poly[1]));
+    p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(log2Poly[0]));
+    __m128 log2 = _mm_add_ps(exponent, _mm_mul_ps(p, m));
+    __m128 db = _mm_add_ps(_mm_mul_ps(log2, _mm_set1_ps(dbPerOctave)), offset);
+    __m128 zero = _mm_cmpeq_ps(power, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(zero, _mm_set1_ps(-std::numeric_limits<float>::infinity())),
+                     _mm_andnot_ps(zero, db));
+}
+
+// |in[i]|^2 for 4 complex samples
+static inline __m128 power4(const float *in)
+{
+    __m128 a = _mm_loadu_ps(in);
+    __m128 b = _mm_loadu_ps(in + 4);
+    a = _mm_mul_ps(a, a);
+    b = _mm_mul_ps(b, b);
+    return _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+                      _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+#endif
+
+void powerComplex(const std::complex<float> *in, float scale, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(scale);
+    auto f = reinterpret_cast<const float*>(in);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(power4(f + i * 2), k));
+#endif
+    for (; i < count; i++)
+        out[i] = std::norm(in[i]) * scale;
+}
+
+void powerComplexDb(const std::complex<float> *in, float offset, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(offset);
+    auto f = reinterpret_cast<const float*>(in);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, fastDb(power4(f + i * 2), k));
+#endif
+    for (; i < count; i++)
+        out[i] = fastDb(std::norm(in[i]), offset);
+}
+
+void powerDb(const float *in, float offset, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(offset);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, fastDb(_mm_loadu_ps(in + i), k));
+#endif
+    for (; i < count; i++)
+        out[i] = fastDb(in[i], offset);
+}
+
+void encodeCentiDb(const float *in, int16_t *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(100.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        // Clamped first, as out of range floats convert to INT32_MIN
+        __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), k), hi), lo);
+        __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), k), hi), lo);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = lrintf(std::max(std::min(in[i] * 100.0f, 32767.0f), -32768.0f));
+}
+
+void decodeCentiDb(const int16_t *in, float *out, size_t count)
+{
+    size_t i = 0;
+    const float negInfinity = -std::numeric_limits<float>::infinity();
+#if defined(__SSE2__)
+    const __m128 k = _mm_set1_ps(0.01f);
+    const __m128 floor = _mm_set1_ps(negInfinity);
+    const __m128i floorLevel = _mm_set1_epi32(INT16_MIN);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i parts[2] = { _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16),
+                             _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16) };
+        for (int j = 0; j < 2; j++) {
+            __m128 db = _mm_mul_ps(_mm_cvtepi32_ps(parts[j]), k);
+            __m128 isFloor = _mm_castsi128_ps(_mm_cmpeq_epi32(parts[j], floorLevel));
+            _mm_storeu_ps(out + i + j * 4, _mm_or_ps(_mm_and_ps(isFloor, floor), _mm_andnot_ps(isFloor, db)));
+        }
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = (in[i] == INT16_MIN) ? negInfinity : in[i] * 0.01f;
+}
+
+void centiDbColorTable(float powerMin, float powerMax, const uint32_t *colormap, uint32_t *table)
+{
+    float powerRange = -1.0f / std::abs(powerMin - powerMax);
+    for (int i = 0; i < 65536; i++) {
+        float normPower = ((i - 32768) * 0.01f - powerMax) * powerRange;
+        normPower = std::max(std::min(normPower, 1.0f), 0.0f);
+        table[i] = colormap[(uint8_t)(normPower * (256 - 1))];
+    }
+}
+
+void colorizeCentiDb(const int16_t *in, size_t stride, const uint32_t *table, uint32_t *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = table[in[i * stride] + 32768];
+}
+
+void amplitudeComplex(const std::complex<float> *in, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    auto f = reinterpret_cast<const float*>(in);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_sub_ps(_mm_mul_ps(power4(f + i * 2), two), one));
+#endif
+    for (; i < count; i++)
+        out[i] = std::norm(in[i]) * 2.0f - 1.0f;
+}
+
+void minMax(const float *in, size_t count, size_t step, float &min, float &max)
+{
+    size_t i = 0;
+    min = std::numeric_limits<float>::infinity();
+    max = -std::numeric_limits<float>::infinity();
+#if defined(__SSE2__)
+    // Unit stride uses every lane; a stride of 2 (one channel of
+    // interleaved I/Q) uses lanes 0 and 2
+    if ((step == 1 || step == 2) && count >= 8) {
+        __m128 vmin = _mm_set1_ps(min);
+        __m128 vmax = _mm_set1_ps(max);
+        size_t perVector = 4 / step;
+        for (; i + perVector <= count - 1; i += perVector) {
+            __m128 v = _mm_loadu_ps(in + i * step);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+        }
+        float mins[4], maxs[4];
+        _mm_storeu_ps(mins, vmin);
+        _mm_storeu_ps(maxs, vmax);
+        for (size_t lane = 0; lane < 4; lane += step) {
+            min = std::min(min, mins[lane]);
+            max = std::max(max, maxs[lane]);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        min = std::min(min, in[i * step]);
+        max = std::max(max, in[i * step]);
+    }
+}
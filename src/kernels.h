@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Inner loops shared by the plots and stages. Each has an SSE2 version
+ * where available and a scalar fallback used for the tail and on other
+ * architectures.
+ */
+
+// out[i] = in[i] * window[i] * scale, widening int16 I/Q to float
+void windowComplexInt16(const std::complex<int16_t> *in, const float *window, float scale,
+                        std::complex<float> *out, size_t count);
+
+// out[i] = in[i] * window[i]
+void windowComplex(const std::complex<float> *in, const float *window,
+                   std::complex<float> *out, size_t count);
+void windowReal(const float *in, const float *window, float *out, size_t count);
+
+// out[i] = |in[i]|^2 * scale
+void powerComplex(const std::complex<float> *in, float scale, float *out, size_t count);
+
+// out[i] = 10 * log10(|in[i]|^2) + offset, using a polynomial log good
+// to about 0.001 dB. Scaling the power by k is the same as adding
+// 10 * log10(k) to the offset. Zero power gives -inf, like log10f
+void powerComplexDb(const std::complex<float> *in, float offset, float *out, size_t count);
+
+// out[i] = 10 * log10(in[i]) + offset, with the same approximation
+void powerDb(const float *in, float offset, float *out, size_t count);
+
+// dB values packed as hundredths of a dB, saturating at +-327.67 dB.
+// -inf (and anything below the range) is stored as INT16_MIN, which
+// decodes back to -inf
+void encodeCentiDb(const float *in, int16_t *out, size_t count);
+void decodeCentiDb(const int16_t *in, float *out, size_t count);
+
+// Colour lookup table with an entry for every centi-dB value, indexed by
+// value + 32768. Values map onto colormap[0..255] the way dB did before
+// packing: index 0 at powerMax and above, 255 at powerMin and below
+// (which includes -inf)
+void centiDbColorTable(float powerMin, float powerMax, const uint32_t *colormap, uint32_t *table);
+// out[i] = table[in[i * stride] + 32768]. A plain gather; SSE2 has none
+void colorizeCentiDb(const int16_t *in, size_t stride, const uint32_t *table, uint32_t *out, size_t count);
+
+// out[i] = |in[i]|^2 * 2 - 1
+void amplitudeComplex(const std::complex<float> *in, float *out, size_t count);
+
+// Minimum and maximum of in[0], in[step], ... in[(count - 1) * step]
+void minMax(const float *in, size_t count, size_t step, float &min, float &max);
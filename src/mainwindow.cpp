@@ -19,7 +19,6 @@
 
 #include <QMessageBox>
 #include <QtWidgets>
-#include <QPixmapCache>
 #include <QRubberBand>
 #include <sstream>
 
@@ -30,8 +29,6 @@ MainWindow::MainWindow()
 {
     setWindowTitle(tr("inspectrum"));
 
-    QPixmapCache::setCacheLimit(40960);
-
     dock = new SpectrogramControls(tr("Controls"), this);
     dock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
     addDockWidget(Qt::LeftDockWidgetArea, dock);
@@ -50,13 +47,16 @@ MainWindow::MainWindow()
 
     connect(dock->sampleRate, static_cast<void (QLineEdit::*)(const QString&)>(&QLineEdit::textChanged), this, static_cast<void (MainWindow::*)(QString)>(&MainWindow::setSampleRate));
     connect(dock->centerFrequency, static_cast<void (QLineEdit::*)(const QString&)>(&QLineEdit::textChanged), this, static_cast<void (MainWindow::*)(QString)>(&MainWindow::setCenterFrequency));
-    connect(dock, static_cast<void (SpectrogramControls::*)(int, int)>(&SpectrogramControls::fftOrZoomChanged), plots, &PlotView::setFFTAndZoom);
+    connect(dock, static_cast<void (SpectrogramControls::*)(int, int, int)>(&SpectrogramControls::fftOrZoomChanged), plots, &PlotView::setFFTAndZoom);
+    connect(dock, &SpectrogramControls::aggregationChanged, plots, &PlotView::setAggregation);
+    connect(dock, &SpectrogramControls::verticalZoomChanged, plots, &PlotView::setVerticalZoom);
     connect(dock->powerMaxSlider, &QSlider::valueChanged, plots, &PlotView::setPowerMax);
     connect(dock->powerMinSlider, &QSlider::valueChanged, plots, &PlotView::setPowerMin);
     connect(dock->squelchSlider, &QSlider::valueChanged, plots, &PlotView::setSquelch);
     connect(dock->cursorsCheckBox, &QCheckBox::stateChanged, plots, &PlotView::enableCursors);
     connect(dock->cursorsFreezeCheckBox, &QCheckBox::stateChanged, plots, &PlotView::freezeCursors);
     connect(dock->scalesCheckBox, &QCheckBox::stateChanged, plots, &PlotView::enableScales);
+    connect(dock->pyramidCheckBox, &QCheckBox::stateChanged, plots, &PlotView::enablePyramid);
     connect(dock->annosCheckBox, &QCheckBox::stateChanged, plots, &PlotView::enableAnnotations);
     connect(dock->annosCheckBox, &QCheckBox::stateChanged, dock, &SpectrogramControls::enableAnnotations);
     connect(dock->commentsCheckBox, &QCheckBox::stateChanged, plots, &PlotView::enableAnnotationCommentsTooltips);
@@ -69,6 +69,7 @@ MainWindow::MainWindow()
     connect(plots, &PlotView::zoomIn, dock, &SpectrogramControls::zoomIn);
     connect(plots, &PlotView::zoomOut, dock, &SpectrogramControls::zoomOut);
     connect(plots, &PlotView::coordinateClick, dock, &SpectrogramControls::coordinateClick);
+    connect(plots, &PlotView::displayRowsChanged, dock, &SpectrogramControls::setDisplayRows);
 
     void coordinateClick(double time_position, double frequency);
 
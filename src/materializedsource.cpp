@@ -0,0 +1,140 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <stdexcept>
+#include <string.h>
+#include "materializedsource.h"
+
+template<typename T>
+const size_t MaterializedSource<T>::chunkSize;
+
+template<typename T>
+MaterializedSource<T>::MaterializedSource(std::shared_ptr<SampleSource<T>> src, range_t<size_t> range)
+    : src(src), range(range), file(QDir::tempPath() + "/inspectrum-XXXXXX.tmp"), materializedUpTo(range.minimum)
+{
+    this->range.maximum = std::min(range.maximum, src->count());
+    this->range.minimum = std::min(range.minimum, this->range.maximum);
+    materializedUpTo = this->range.minimum;
+
+    auto size = this->range.length() * sizeof(T);
+    if (size > 0) {
+        if (!file.open() || !file.resize(size))
+            throw std::runtime_error("Error creating scratch file");
+        data = reinterpret_cast<T*>(file.map(0, size));
+        if (data == nullptr)
+            throw std::runtime_error("Error mmapping scratch file");
+    }
+
+    restartTimer.setSingleShot(true);
+    restartTimer.setInterval(restartDelayMs);
+    QObject::connect(&restartTimer, &QTimer::timeout, [this]() { start(); });
+
+    src->subscribe(this);
+    start();
+}
+
+template<typename T>
+MaterializedSource<T>::~MaterializedSource()
+{
+    src->unsubscribe(this);
+    restartTimer.stop();
+    stop();
+    if (data != nullptr)
+        file.unmap(reinterpret_cast<uchar*>(data));
+}
+
+template<typename T>
+void MaterializedSource<T>::start()
+{
+    if (data == nullptr)
+        return;
+
+    quint64 generation = this->generation;
+    request = AsyncRequest::run([this, generation](AsyncRequest &request) {
+        for (size_t pos = range.minimum; pos < range.maximum; pos += chunkSize) {
+            if (request.isCancelled())
+                return;
+
+            auto length = std::min(chunkSize, range.maximum - pos);
+            auto samples = src->getSamples(pos, length);
+            if (samples == nullptr)
+                return;
+
+            QMutexLocker ml(&writeMutex);
+            if (generation != this->generation)
+                return;
+            memcpy(data + (pos - range.minimum), samples.get(), length * sizeof(T));
+            materializedUpTo.store(pos + length, std::memory_order_release);
+        }
+    }, AsyncRequest::Prefetch);
+}
+
+template<typename T>
+void MaterializedSource<T>::stop()
+{
+    if (request) {
+        retired.add(request);
+        request.reset();
+    }
+    retired.waitForFinished();
+}
+
+template<typename T>
+void MaterializedSource<T>::invalidateEvent()
+{
+    // The stage feeding us changed, so everything written so far is
+    // stale. This happens on every tuner drag, so the running job isn't
+    // waited for (at most this waits for it to finish copying one chunk),
+    // and the new pass only starts once the changes have settled
+    {
+        QMutexLocker ml(&writeMutex);
+        generation++;
+        materializedUpTo = range.minimum;
+    }
+    if (request) {
+        retired.add(request);
+        request.reset();
+    }
+    restartTimer.start();
+    SampleSource<T>::invalidate();
+}
+
+template<typename T>
+std::unique_ptr<T[]> MaterializedSource<T>::getSamples(size_t start, size_t length)
+{
+    quint64 generation;
+    {
+        QMutexLocker ml(&writeMutex);
+        generation = this->generation;
+    }
+    if (start >= range.minimum && start + length <= materializedUpTo.load(std::memory_order_acquire)) {
+        auto dest = std::make_unique<T[]>(length);
+        memcpy(dest.get(), data + (start - range.minimum), length * sizeof(T));
+        // A newer pass may have started overwriting the range mid-copy
+        QMutexLocker ml(&writeMutex);
+        if (generation == this->generation)
+            return dest;
+    }
+
+    return src->getSamples(start, length);
+}
+
+template class MaterializedSource<std::complex<float>>;
+template class MaterializedSource<float>;
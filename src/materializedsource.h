@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include "samplesource.h"
+
+/*
+ * Runs a derived stream once over a range of samples in the background
+ * and keeps the result in a memory-mapped scratch file. Requests that
+ * fall inside the part written so far are served from the mapping;
+ * anything else is passed through to the source.
+ */
+template<typename T>
+class MaterializedSource : public SampleSource<T>, public Subscriber
+{
+public:
+    MaterializedSource(std::shared_ptr<SampleSource<T>> src, range_t<size_t> range);
+    ~MaterializedSource();
+    void invalidateEvent() override;
+    std::unique_ptr<T[]> getSamples(size_t start, size_t length) override;
+
+    size_t count() override {
+        return src->count();
+    };
+    double rate() override {
+        return src->rate();
+    };
+    float relativeBandwidth() override {
+        return src->relativeBandwidth();
+    };
+    bool realSignal() override {
+        return src->realSignal();
+    };
+
+private:
+    static const size_t chunkSize = 1 << 20;
+    // Quiet time after a change (e.g. a tuner drag) before starting over
+    static const int restartDelayMs = 500;
+
+    std::shared_ptr<SampleSource<T>> src;
+    range_t<size_t> range;
+    QTemporaryFile file;
+    T *data = nullptr;
+    // End of the contiguous materialized region starting at range.minimum
+    std::atomic<size_t> materializedUpTo;
+    // Bumped when the source changes. Jobs only write while it matches the
+    // one they started with, checked under writeMutex, so a superseded job
+    // can be left to notice on its own rather than waited for
+    quint64 generation = 0;
+    QMutex writeMutex;
+    std::shared_ptr<AsyncRequest> request;
+    RetiredRequests retired;
+    QTimer restartTimer;
+
+    void start();
+    void stop();
+};
@@ -0,0 +1,114 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include "cachebudget.h"
+
+/*
+ * QCache costed by the size of each entry, with its limit set by
+ * CacheBudget and counters for the cache statistics in the UI.
+ *
+ * Values are copied in and out under a lock, so it can be used from
+ * worker threads. T should be cheap to copy (implicitly shared, or a
+ * shared_ptr).
+ */
+template<typename Key, typename T>
+class MemoryCache : public BudgetedCache
+{
+public:
+    MemoryCache(CacheBudget::Category category) : category(category) {
+        CacheBudget::instance().add(category, this);
+    }
+
+    ~MemoryCache() {
+        CacheBudget::instance().remove(category, this);
+    }
+
+    bool find(const Key &key, T *value) {
+        QMutexLocker ml(&mutex);
+        auto obj = cache.object(key);
+        if (obj == nullptr) {
+            counters.misses++;
+            return false;
+        }
+        counters.hits++;
+        *value = *obj;
+        return true;
+    }
+
+    // Neither of these counts towards the hit rate
+    bool contains(const Key &key) {
+        QMutexLocker ml(&mutex);
+        return cache.contains(key);
+    }
+
+    bool peek(const Key &key, T *value) {
+        QMutexLocker ml(&mutex);
+        auto obj = cache.object(key);
+        if (obj == nullptr)
+            return false;
+        *value = *obj;
+        return true;
+    }
+
+    void insert(const Key &key, const T &value, qint64 bytes) {
+        QMutexLocker ml(&mutex);
+        int expected = cache.count() + (cache.contains(key) ? 0 : 1);
+        cache.insert(key, new T(value), cost(bytes));
+        // Values too big for the whole cache are dropped straight away,
+        // which counts as an eviction too
+        counters.evictions += expected - cache.count();
+    }
+
+    void clear() {
+        QMutexLocker ml(&mutex);
+        cache.clear();
+    }
+
+    void setLimit(qint64 bytes) override {
+        QMutexLocker ml(&mutex);
+        int count = cache.count();
+        cache.setMaxCost(cost(bytes));
+        counters.evictions += count - cache.count();
+    }
+
+    CacheStats stats() override {
+        QMutexLocker ml(&mutex);
+        CacheStats stats = counters;
+        stats.bytes = qint64(cache.totalCost()) << 10;
+        stats.limit = qint64(cache.maxCost()) << 10;
+        return stats;
+    }
+
+private:
+    // QCache costs are ints, so count in KiB to allow budgets past 2 GiB
+    static int cost(qint64 bytes) {
+        return int(std::max<qint64>(1, (bytes + 1023) >> 10));
+    }
+
+    CacheBudget::Category category;
+    QMutex mutex;
+    QCache<Key, T> cache;
+    CacheStats counters;
+};
@@ -22,9 +22,16 @@
 #include <QMouseEvent>
 #include <QObject>
 #include <QPainter>
+#include <vector>
 #include "abstractsamplesource.h"
 #include "util.h"
 
+// Samples a plot should get ready to draw soon, at a given zoom
+struct PrefetchRegion {
+    range_t<size_t> sampleRange;
+    size_t samplesPerColumn;
+};
+
 class Plot : public QObject, public Subscriber
 {
     Q_OBJECT
@@ -38,6 +45,9 @@ public:
     virtual void paintBack(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
     virtual void paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
     virtual void paintFront(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
+    // Queues low priority work for tiles in these regions. Each call
+    // replaces the last, cancelling prefetches no longer wanted.
+    virtual void prefetch(const std::vector<PrefetchRegion> &regions) { };
     int height() const { return _height; };
 
 signals:
@@ -18,6 +18,7 @@
  */
 
 #include "amplitudedemod.h"
+#include "bandspectrogramplot.h"
 #include "frequencydemod.h"
 #include "phasedemod.h"
 #include "threshold.h"
@@ -60,3 +61,14 @@ Plot* Plots::thresholdPlot(std::shared_ptr<AbstractSampleSource> source)
     std::shared_ptr<Source> concrete= std::dynamic_pointer_cast<Source>(source);
     return new TracePlot( std::make_shared<Threshold>( concrete ) );
 }
+
+Plot* Plots::bandSpectrogramPlot(std::shared_ptr<AbstractSampleSource> source)
+{
+    // Zoom in on the tuner band, or show the whole band of anything else
+    auto tuner = std::dynamic_pointer_cast<TunerTransform>(source);
+    if (tuner == nullptr) {
+        typedef SampleSource<std::complex<float>> Source;
+        tuner = std::make_shared<TunerTransform>(std::dynamic_pointer_cast<Source>(source));
+    }
+    return new BandSpectrogramPlot(tuner);
+}
@@ -41,6 +41,7 @@ public:
     static Plot* frequencyPlot(std::shared_ptr<AbstractSampleSource> source);
     static Plot* phasePlot(std::shared_ptr<AbstractSampleSource> source);
     static Plot* thresholdPlot(std::shared_ptr<AbstractSampleSource> source);
+    static Plot* bandSpectrogramPlot(std::shared_ptr<AbstractSampleSource> source);
 
     static class _init
     {
@@ -50,6 +51,7 @@ public:
             plots.emplace(typeid(std::complex<float>), PlotInfo{"amplitude plot", amplitudePlot});
             plots.emplace(typeid(std::complex<float>), PlotInfo{"frequency plot", frequencyPlot});
             plots.emplace(typeid(std::complex<float>), PlotInfo{"phase plot", phasePlot});
+            plots.emplace(typeid(std::complex<float>), PlotInfo{"band spectrogram", bandSpectrogramPlot});
             plots.emplace(typeid(float), PlotInfo{"threshold plot", thresholdPlot});
         };
     } _initializer;
@@ -20,6 +20,7 @@
 #include "plotview.h"
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <QtGlobal>
 #include <QApplication>
 #include <QClipboard>
@@ -40,6 +41,7 @@
 #include <QMessageBox>
 #include <QSettings>
 
+#include "framescheduler.h"
 #include "plots.h"
 #include "symbolprogoutput.h"
 #include "frequencydemod.h"
@@ -69,12 +71,35 @@ PlotView::PlotView(InputSource *input, Tuner *tuner) : cursors(this), viewRange(
     addPlot(spectrogramPlot);
 
     mainSampleSource->subscribe(this);
+
+    prefetchIdleTimer.setSingleShot(true);
+    prefetchIdleTimer.setInterval(scrollIdleMs);
+    connect(&prefetchIdleTimer, &QTimer::timeout, this, [this]() {
+        scrollDirection = 0;
+        scrollVelocity = 0;
+        updatePrefetch(true);
+    });
+
+    // Plots ask for repaints as tiles arrive; draw them at most once a frame
+    connect(&FrameScheduler::instance(), &FrameScheduler::frame, this, [this]() {
+        viewport()->update();
+    });
 }
 
 void PlotView::addPlot(Plot *plot)
 {
     plots.emplace_back(plot);
     connect(plot, &Plot::repaint, this, &PlotView::repaint);
+    if (auto band = dynamic_cast<BandSpectrogramPlot*>(plot))
+        band->setPowerRange(powerMin, powerMax);
+}
+
+void PlotView::updateBandPlotsPower()
+{
+    for (auto &plot : plots) {
+        if (auto band = dynamic_cast<BandSpectrogramPlot*>(plot.get()))
+            band->setPowerRange(powerMin, powerMax);
+    }
 }
 
 void PlotView::mouseMoveEvent(QMouseEvent *event)
@@ -206,6 +231,24 @@ void PlotView::contextMenuEvent(QContextMenuEvent * event)
     );
     menu.addAction(save);
 
+    // Add action to compute the selected plot's stream once and serve it from disk
+    auto materialize = new QAction("Materialize stream", &menu);
+    connect(
+        materialize, &QAction::triggered,
+        this, [=]() {
+            materializePlot(it);
+        }
+    );
+    // A band spectrogram's output is its tuner, which isn't what it shows
+    materialize->setEnabled(
+        selectedPlot != spectrogramPlot &&
+        dynamic_cast<BandSpectrogramPlot*>(selectedPlot) == nullptr &&
+        std::dynamic_pointer_cast<InputSource>(src) == nullptr &&
+        std::dynamic_pointer_cast<MaterializedSource<std::complex<float>>>(src) == nullptr &&
+        std::dynamic_pointer_cast<MaterializedSource<float>>(src) == nullptr
+    );
+    menu.addAction(materialize);
+
     // Add action to remove the selected plot
     auto rem = new QAction("Remove plot", &menu);
     connect(
@@ -225,6 +268,34 @@ void PlotView::contextMenuEvent(QContextMenuEvent * event)
 
 }
 
+void PlotView::materializePlot(std::vector<std::unique_ptr<Plot>>::iterator it)
+{
+    auto src = (*it)->output();
+
+    // Materialize the selection if there is one, otherwise the whole stream
+    range_t<size_t> range = {0, std::numeric_limits<size_t>::max()};
+    if (cursorsEnabled)
+        range = selectedSamples;
+
+    std::shared_ptr<AbstractSampleSource> materialized;
+    try {
+        if (auto concrete = std::dynamic_pointer_cast<SampleSource<std::complex<float>>>(src))
+            materialized = std::make_shared<MaterializedSource<std::complex<float>>>(concrete, range);
+        else if (auto concrete = std::dynamic_pointer_cast<SampleSource<float>>(src))
+            materialized = std::make_shared<MaterializedSource<float>>(concrete, range);
+        else
+            return;
+    } catch (const std::exception &ex) {
+        QMessageBox::critical(this, "Error", QString("Failed to materialize stream: %1").arg(ex.what()));
+        return;
+    }
+
+    auto plot = new TracePlot(materialized);
+    connect(plot, &Plot::repaint, this, &PlotView::repaint);
+    last_src_used = nullptr;
+    it->reset(plot);
+}
+
 void PlotView::cursorsMoved()
 {
     selectedSamples = {
@@ -376,7 +447,8 @@ bool PlotView::viewportEvent(QEvent *event) {
 
         } else if (QApplication::keyboardModifiers() & Qt::ControlModifier) {
             bool canZoomIn = zoomLevel < fftSize;
-            bool canZoomOut = zoomLevel > 1;
+            // The zoom slider bounds how many FFTs get folded into a column
+            bool canZoomOut = true;
             if ((delta > 0 && canZoomIn) || (delta < 0 && canZoomOut)) {
                 scrollZoomStepsAccumulated += delta;
 
@@ -648,8 +720,10 @@ void PlotView::exportSamples(std::shared_ptr<AbstractSampleSource> src)
         std::ofstream os (fileNames[0].toStdString(), std::ios::binary);
 
         size_t index;
-        // viewRange.length() is used as some less arbitrary step value
-        size_t step = viewRange.length();
+        // Fixed-size steps keep memory bounded for "Complete File"; each
+        // step is large enough for derived sources to split it across threads
+        const size_t step = 1 << 24;
+        const size_t decimationStep = decimation.value();
 
         QProgressDialog progress("Exporting samples...", "Cancel", start, end, this);
         progress.setWindowModality(Qt::WindowModal);
@@ -661,7 +735,9 @@ void PlotView::exportSamples(std::shared_ptr<AbstractSampleSource> src)
             size_t length = std::min(step, end - index);
             auto samples = sampleSrc->getSamples(index, length);
             if (samples != nullptr) {
-                for (auto i = 0; i < length; i += decimation.value()) {
+                // Keep the decimation phase aligned to the start of the export
+                size_t first = (decimationStep - (index - start) % decimationStep) % decimationStep;
+                for (auto i = first; i < length; i += decimationStep) {
                     os.write((const char*)&samples[i], sizeof(SOURCETYPE));
                 }
             }
@@ -671,13 +747,15 @@ void PlotView::exportSamples(std::shared_ptr<AbstractSampleSource> src)
 
 void PlotView::invalidateEvent()
 {
+    // A newly opened file may be real, which halves what is shown
+    updateRowLimit();
     horizontalScrollBar()->setMinimum(0);
     horizontalScrollBar()->setMaximum(sampleToColumn(mainSampleSource->count()));
 }
 
 void PlotView::repaint()
 {
-    viewport()->update();
+    FrameScheduler::instance().requestFrame();
 }
 
 #include <iostream>
@@ -696,7 +774,7 @@ void PlotView::setCursorSegments(int segments)
     emitTimeSelection();
 }
 
-void PlotView::setFFTAndZoom(int size, int zoom)
+void PlotView::setFFTAndZoom(int size, int zoom, int ffts)
 {
     auto oldSamplesPerColumn = samplesPerColumn();
 
@@ -704,17 +782,30 @@ void PlotView::setFFTAndZoom(int size, int zoom)
     fftSize = size;
     if (spectrogramPlot != nullptr)
         spectrogramPlot->setFFTSize(size);
+    updateRowLimit();
 
     // Set new zoom level
     zoomLevel = zoom;
     if (spectrogramPlot != nullptr)
         spectrogramPlot->setZoomLevel(zoom);
 
+    fftsPerColumn = ffts;
+    if (spectrogramPlot != nullptr)
+        spectrogramPlot->setFFTsPerColumn(ffts);
+
     // Update horizontal (time) scrollbar
     horizontalScrollBar()->setSingleStep(10);
     horizontalScrollBar()->setPageStep(100);
 
     updateView(true, samplesPerColumn() < oldSamplesPerColumn);
+    prefetchIdleTimer.start();
+}
+
+void PlotView::setAggregation(int aggregation, int percentile)
+{
+    if (spectrogramPlot != nullptr)
+        spectrogramPlot->setAggregation(aggregation, percentile);
+    updateView();
 }
 
 void PlotView::setPowerMin(int power)
@@ -722,11 +813,13 @@ void PlotView::setPowerMin(int power)
     powerMin = power;
     if (spectrogramPlot != nullptr)
         spectrogramPlot->setPowerMin(power);
+    updateBandPlotsPower();
     updateView();
 }
 
 void PlotView::setSquelch(int sq) {
 	squelch = sq;
+	FrequencyDemod::params.set({sq});
 	if (spectrogramPlot != nullptr)
 		spectrogramPlot->setSquelch(sq);
     updateView();
@@ -759,6 +852,7 @@ void PlotView::setPowerMax(int power)
     powerMax = power;
     if (spectrogramPlot != nullptr)
         spectrogramPlot->setPowerMax(power);
+    updateBandPlotsPower();
     updateView();
 }
 
@@ -766,6 +860,7 @@ void PlotView::paintEvent(QPaintEvent *event)
 {
     if (mainSampleSource == nullptr) return;
 
+    FrameScheduler::instance().beginFrame();
     QRect rect = QRect(0, 0, width(), height());
     QPainter painter(viewport());
     painter.fillRect(rect, Qt::black);
@@ -790,6 +885,7 @@ void PlotView::paintEvent(QPaintEvent *event)
     if (timeScaleEnabled) {
         paintTimeScale(painter, rect, viewRange);
     }
+    FrameScheduler::instance().endFrame();
 
 
 #undef PLOT_LAYER
@@ -859,17 +955,93 @@ int PlotView::plotsHeight()
 
 void PlotView::resizeEvent(QResizeEvent * event)
 {
+    updateRowLimit();
     updateView();
 }
 
+void PlotView::setVerticalZoom(int factor)
+{
+    verticalZoom = factor;
+    updateRowLimit();
+    updateView();
+}
+
+void PlotView::updateRowLimit()
+{
+    if (spectrogramPlot == nullptr)
+        return;
+
+    // Only as many rows as the window can show, unless zoomed in to see
+    // more of the bins. Real signals only show half of them
+    int wanted = std::max(1, viewport()->height()) * verticalZoom;
+    auto input = dynamic_cast<InputSource*>(mainSampleSource);
+    if (input != nullptr && input->realSignal())
+        wanted *= 2;
+    int rows = 1;
+    while (rows < wanted)
+        rows <<= 1;
+
+    spectrogramPlot->setRowLimit(rows);
+    emit displayRowsChanged(spectrogramPlot->displayRows());
+}
+
 size_t PlotView::samplesPerColumn()
 {
-    return fftSize / zoomLevel;
+    return size_t(fftSize) * fftsPerColumn / zoomLevel;
 }
 
 void PlotView::scrollContentsBy(int dx, int dy)
 {
     updateView();
+
+    if (dx != 0) {
+        // Content moving left means we're heading later in the recording
+        int direction = (dx < 0) ? 1 : -1;
+        qint64 elapsed = scrollTimer.isValid() ? scrollTimer.restart() : -1;
+        if (elapsed < 0)
+            scrollTimer.start();
+        if (elapsed < 0 || elapsed > scrollIdleMs || direction != scrollDirection)
+            scrollVelocity = 0; // Start the estimate again
+        else
+            scrollVelocity = 0.7 * scrollVelocity + 0.3 * std::abs(dx) * 1000.0 / std::max<qint64>(1, elapsed);
+        scrollDirection = direction;
+        updatePrefetch(false);
+    }
+    prefetchIdleTimer.start();
+}
+
+void PlotView::updatePrefetch(bool idle)
+{
+    if (mainSampleSource == nullptr || mainSampleSource->count() == 0)
+        return;
+
+    std::vector<PrefetchRegion> regions;
+    size_t spc = samplesPerColumn();
+    size_t screen = size_t(width()) * spc;
+
+    if (idle) {
+        // Nothing moving, so get a screen either side and the
+        // neighbouring zoom levels ready
+        size_t start = viewRange.minimum > screen ? viewRange.minimum - screen : 0;
+        regions.push_back({{start, viewRange.maximum + screen}, spc});
+        regions.push_back({viewRange, spc * 2});
+        if (spc > 1)
+            regions.push_back({viewRange, spc / 2});
+    } else {
+        // Look ahead as far as we'll scroll in the next second, but
+        // at least one screen and at most a few
+        size_t columns = std::max<size_t>(width(), scrollVelocity * prefetchLookaheadSeconds);
+        size_t ahead = std::min<size_t>(columns, width() * maxPrefetchScreens) * spc;
+        if (scrollDirection > 0) {
+            regions.push_back({{viewRange.maximum, viewRange.maximum + ahead}, spc});
+        } else if (scrollDirection < 0) {
+            size_t start = viewRange.minimum > ahead ? viewRange.minimum - ahead : 0;
+            regions.push_back({{start, viewRange.minimum}, spc});
+        }
+    }
+
+    for (auto&& plot : plots)
+        plot->prefetch(regions);
 }
 
 void PlotView::showEvent(QShowEvent *event)
@@ -945,6 +1117,12 @@ void PlotView::enableScales(bool enabled)
     viewport()->update();
 }
 
+void PlotView::enablePyramid(bool enabled)
+{
+    if (spectrogramPlot != nullptr)
+        spectrogramPlot->setPyramidEnabled(enabled);
+}
+
 void PlotView::enableAnnotations(bool enabled)
 {
     if (spectrogramPlot != nullptr)
@@ -20,10 +20,14 @@
 #pragma once
 
 #include <QGraphicsView>
+#include <QElapsedTimer>
 #include <QPaintEvent>
+#include <QTimer>
 
+#include "bandspectrogramplot.h"
 #include "cursors.h"
 #include "inputsource.h"
+#include "materializedsource.h"
 #include "plot.h"
 #include "samplesource.h"
 #include "spectrogramplot.h"
@@ -48,6 +52,7 @@ signals:
     void zoomIn();
     void zoomOut();
     void coordinateClick(double time_position, double frequency, bool down);
+    void displayRowsChanged(int rows);
 
 
 public slots:
@@ -55,12 +60,15 @@ public slots:
     void enableCursors(bool enabled);
     void freezeCursors(bool enabled);
     void enableScales(bool enabled);
+    void enablePyramid(bool enabled);
     void enableAnnotations(bool enabled);
     void enableAnnotationCommentsTooltips(bool enabled);
     void invalidateEvent() override;
     void repaint();
     void setCursorSegments(int segments);
-    void setFFTAndZoom(int fftSize, int zoomLevel);
+    void setFFTAndZoom(int fftSize, int zoomLevel, int fftsPerColumn);
+    void setAggregation(int aggregation, int percentile);
+    void setVerticalZoom(int factor);
     void setPowerMin(int power);
     void setPowerMax(int power);
     void setSquelch(int squelch);
@@ -90,6 +98,8 @@ private:
 
     int fftSize = 1024;
     int zoomLevel = 1;
+    int fftsPerColumn = 1;
+    int verticalZoom = 1;
     int powerMin;
     int powerMax;
     int squelch;
@@ -99,11 +109,21 @@ private:
     double centerFrequency = 0.0;
     bool timeScaleEnabled;
     int scrollZoomStepsAccumulated = 0;
+
+    // Scrolling state for prefetching, in columns per second
+    static const int scrollIdleMs = 300;
+    static constexpr double prefetchLookaheadSeconds = 1.0;
+    static const int maxPrefetchScreens = 4;
+    int scrollDirection = 0;
+    double scrollVelocity = 0;
+    QElapsedTimer scrollTimer;
+    QTimer prefetchIdleTimer;
     bool annotationCommentsEnabled;
     std::shared_ptr<AbstractSampleSource> last_src_used;
 
 
     void addPlot(Plot *plot);
+    void updateBandPlotsPower();
     void emitTimeSelection();
     void extractSymbols(std::shared_ptr<AbstractSampleSource> src, bool toClipboard);
 
@@ -111,10 +131,13 @@ private:
     void feedSymbolsToExternalProgram(QString programPath, std::shared_ptr<AbstractSampleSource> src);
     void exportSamples(std::shared_ptr<AbstractSampleSource> src);
     template<typename SOURCETYPE> void exportSamples(std::shared_ptr<AbstractSampleSource> src);
+    void materializePlot(std::vector<std::unique_ptr<Plot>>::iterator it);
     int plotsHeight();
     size_t samplesPerColumn();
+    void updateRowLimit();
     void updateViewRange(bool reCenter);
     void updateView(bool reCenter = false, bool expanding = false);
+    void updatePrefetch(bool idle);
     void paintTimeScale(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
     void updateAnnotationTooltip(QMouseEvent *event);
 
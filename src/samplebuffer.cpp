@@ -17,10 +17,15 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <QMutexLocker>
+#include <QtConcurrent>
+#include <atomic>
 #include <string.h>
+#include <vector>
 #include "samplebuffer.h"
 
+template <typename Tin, typename Tout>
+const size_t SampleBuffer<Tin, Tout>::chunkSize;
+
 template <typename Tin, typename Tout>
 SampleBuffer<Tin, Tout>::SampleBuffer(std::shared_ptr<SampleSource<Tin>> src) : src(src)
 {
@@ -36,17 +41,53 @@ SampleBuffer<Tin, Tout>::~SampleBuffer()
 template <typename Tin, typename Tout>
 std::unique_ptr<Tout[]> SampleBuffer<Tin, Tout>::getSamples(size_t start, size_t length)
 {
-    // TODO: base this on the actual history required
-    auto history = std::min(start, (size_t)256);
+    if (length > parallelThreshold)
+        return getSamplesChunked(start, length);
+
+    auto dest = std::make_unique<Tout[]>(length);
+    if (!processRange(start, length, dest.get()))
+        return nullptr;
+    return dest;
+}
+
+template <typename Tin, typename Tout>
+bool SampleBuffer<Tin, Tout>::processRange(size_t start, size_t length, Tout *dest)
+{
+    auto history = std::min(start, this->history());
     auto samples = src->getSamples(start - history, length + history);
     if (samples == nullptr)
-        return nullptr;
+        return false;
 
+    // sampleid is that of the first sample passed in, so anything
+    // phase-dependent stays continuous across chunk boundaries
     auto temp = std::make_unique<Tout[]>(history + length);
+    work(samples.get(), temp.get(), history + length, start - history);
+    memcpy(dest, temp.get() + history, length * sizeof(Tout));
+    return true;
+}
+
+template <typename Tin, typename Tout>
+std::unique_ptr<Tout[]> SampleBuffer<Tin, Tout>::getSamplesChunked(size_t start, size_t length)
+{
     auto dest = std::make_unique<Tout[]>(length);
-    QMutexLocker ml(&mutex);
-    work(samples.get(), temp.get(), history + length, start);
-    memcpy(dest.get(), temp.get() + history, length * sizeof(Tout));
+
+    std::vector<size_t> offsets;
+    for (size_t offset = 0; offset < length; offset += chunkSize)
+        offsets.push_back(offset);
+
+    // Each chunk fetches its own history, so they are independent and
+    // only ever have a chunk's worth of input in flight per thread
+    std::atomic<bool> failed{false};
+    QtConcurrent::blockingMap(offsets, [&](size_t offset) {
+        if (failed)
+            return;
+        auto chunkLength = std::min(chunkSize, length - offset);
+        if (!processRange(start + offset, chunkLength, dest.get() + offset))
+            failed = true;
+    });
+
+    if (failed)
+        return nullptr;
     return dest;
 }
 
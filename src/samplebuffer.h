@@ -19,7 +19,6 @@
 
 #pragma once
 
-#include <QMutex>
 #include <complex>
 #include <memory>
 #include "samplesource.h"
@@ -29,20 +28,35 @@ class SampleBuffer : public SampleSource<Tout>, public Subscriber
 {
 private:
     std::shared_ptr<SampleSource<Tin>> src;
-    QMutex mutex;
+
+    // Requests longer than parallelThreshold are split into chunks
+    // of chunkSize samples and run across the global thread pool
+    static const size_t chunkSize = 1 << 20;
+    static const size_t parallelThreshold = 2 * chunkSize;
+
+    bool processRange(size_t start, size_t length, Tout *dest);
+    std::unique_ptr<Tout[]> getSamplesChunked(size_t start, size_t length);
 
 public:
     SampleBuffer(std::shared_ptr<SampleSource<Tin>> src);
     ~SampleBuffer();
     void invalidateEvent();
     virtual std::unique_ptr<Tout[]> getSamples(size_t start, size_t length);
+    // work() may be called from several threads at once
     virtual void work(void *input, void *output, int count, size_t sampleid) = 0;
+    // Number of input samples work() needs before the first output sample
+    virtual size_t history() {
+        return 256;
+    };
     virtual size_t count() {
         return src->count();
     };
     double rate() {
         return src->rate();
     };
+    std::shared_ptr<SampleSource<Tin>> input() {
+        return src;
+    };
 
     float relativeBandwidth() {
         return src->relativeBandwidth();
@@ -31,5 +31,17 @@ double SampleSource<T>::getFrequency()
     return frequency;
 }
 
+template<typename T>
+std::shared_ptr<AsyncRequest> SampleSource<T>::requestSamples(size_t start, size_t length,
+                                                              std::function<void(std::unique_ptr<T[]>)> callback,
+                                                              int priority)
+{
+    return AsyncRequest::run([=](AsyncRequest &request) {
+        auto samples = getSamples(start, length);
+        if (!request.isCancelled())
+            callback(std::move(samples));
+    }, priority);
+}
+
 template class SampleSource<std::complex<float>>;
 template class SampleSource<float>;
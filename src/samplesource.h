@@ -20,8 +20,10 @@
 #pragma once
 
 #include <complex>
+#include <functional>
 #include <memory>
 #include "abstractsamplesource.h"
+#include "asyncrequest.h"
 
 #include "util.h"
 #include <QString>
@@ -51,6 +53,11 @@ public:
     virtual ~SampleSource() {};
 
     virtual std::unique_ptr<T[]> getSamples(size_t start, size_t length) = 0;
+    // Runs getSamples() on the thread pool and hands the result to callback
+    // there. The source must outlive the request (cancel and wait on it).
+    std::shared_ptr<AsyncRequest> requestSamples(size_t start, size_t length,
+                                                 std::function<void(std::unique_ptr<T[]>)> callback,
+                                                 int priority = AsyncRequest::Normal);
     virtual void invalidateEvent() { };
     virtual size_t count() = 0;
     virtual double rate() = 0;
@@ -58,5 +65,10 @@ public:
     std::vector<Annotation> annotationList;
     std::type_index sampleType() override;
     virtual bool realSignal() { return false; };
+    // Backing file, if the samples come straight from one
+    virtual QString fileName() { return QString(); };
+    // Changes whenever the samples could have, for caches that outlive
+    // the process (empty if the source can't say)
+    virtual QString identity() { return QString(); };
     double getFrequency();
 };
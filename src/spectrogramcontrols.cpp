@@ -25,6 +25,8 @@
 #include <QLabel>
 #include <QHBoxLayout>
 #include <cmath>
+#include "cachebudget.h"
+#include "spectrogramplot.h"
 #include "util.h"
 
 SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent)
@@ -56,7 +58,7 @@ SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent
     layout->addRow(new QLabel(tr("<b>Spectrogram</b>")));
 
     fftSizeSlider = new QSlider(Qt::Horizontal, widget);
-    fftSizeSlider->setRange(4, 13);
+    fftSizeSlider->setRange(4, 20);
     fftSizeSlider->setPageStep(1);
     fftSizeSlider->setMinimumWidth(120);
 
@@ -71,7 +73,8 @@ SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent
     layout->addRow(fftSizeWidget, fftSizeSlider);
 
     zoomLevelSlider = new QSlider(Qt::Horizontal, widget);
-    zoomLevelSlider->setRange(0, 10);
+    // Negative values zoom out past one FFT per column
+    zoomLevelSlider->setRange(-16, 10);
     zoomLevelSlider->setPageStep(1);
     zoomLevelSlider->setMinimumWidth(120);
 
@@ -85,6 +88,38 @@ SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent
     zoomLevelLayout->addStretch();
     layout->addRow(zoomLevelWidget, zoomLevelSlider);
 
+    verticalZoomSlider = new QSlider(Qt::Horizontal, widget);
+    // Powers of two; at 1x the spectrum is pooled down to fit the window
+    verticalZoomSlider->setRange(0, 6);
+    verticalZoomSlider->setPageStep(1);
+    verticalZoomSlider->setMinimumWidth(120);
+
+    verticalZoomValueLabel = new QLabel();
+    verticalZoomLabel = new QLabel(tr("Vertical zoom:"));
+    QWidget *verticalZoomWidget = new QWidget(widget);
+    QHBoxLayout *verticalZoomLayout = new QHBoxLayout(verticalZoomWidget);
+    verticalZoomLayout->setContentsMargins(0, 0, 0, 0);
+    verticalZoomLayout->addWidget(verticalZoomValueLabel);
+    verticalZoomLayout->addWidget(verticalZoomLabel);
+    verticalZoomLayout->addStretch();
+    layout->addRow(verticalZoomWidget, verticalZoomSlider);
+
+    aggregationComboBox = new QComboBox(widget);
+    aggregationComboBox->addItem(tr("Mean"), SpectrogramPlot::Mean);
+    aggregationComboBox->addItem(tr("Max hold"), SpectrogramPlot::Max);
+    aggregationComboBox->addItem(tr("Percentile"), SpectrogramPlot::Percentile);
+    layout->addRow(new QLabel(tr("Zoomed out:")), aggregationComboBox);
+
+    aggregationPercentileSpinBox = new QSpinBox(widget);
+    aggregationPercentileSpinBox->setRange(1, 99);
+    aggregationPercentileSpinBox->setValue(90);
+    aggregationPercentileSpinBox->setSuffix("%");
+    layout->addRow(new QLabel(tr("Percentile:")), aggregationPercentileSpinBox);
+
+    pyramidCheckBox = new QCheckBox(widget);
+    pyramidCheckBox->setToolTip(tr("Build a zoomed-out overview of the whole recording in the background and keep it alongside the file"));
+    layout->addRow(new QLabel(tr("Save overview:")), pyramidCheckBox);
+
     powerMaxSlider = new QSlider(Qt::Horizontal, widget);
     powerMaxSlider->setRange(-140, 10);
     powerMaxSlider->setMinimumWidth(120);
@@ -185,6 +220,22 @@ SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent
     deltaTimeLabel = new QLabel();
     layout->addRow(new QLabel(tr("Delta:")), deltaTimeLabel);
 
+    // Cache settings
+    layout->addRow(new QLabel()); // TODO: find a better way to add an empty row?
+    layout->addRow(new QLabel(tr("<b>Caches</b>")));
+
+    cacheMemorySpinBox = new QSpinBox(widget);
+    cacheMemorySpinBox->setRange(64, 1 << 20);
+    cacheMemorySpinBox->setSingleStep(256);
+    cacheMemorySpinBox->setSuffix(tr(" MB"));
+    layout->addRow(new QLabel(tr("Memory budget:")), cacheMemorySpinBox);
+
+    cacheStatsLabel = new QLabel();
+    layout->addRow(cacheStatsLabel);
+
+    cacheStatsTimer = new QTimer(this);
+    cacheStatsTimer->setInterval(1000);
+
 
 
 
@@ -196,12 +247,19 @@ SpectrogramControls::SpectrogramControls(const QString & title, QWidget * parent
 
     connect(fftSizeSlider, &QSlider::valueChanged, this, &SpectrogramControls::fftSizeChanged);
     connect(zoomLevelSlider, &QSlider::valueChanged, this, &SpectrogramControls::zoomLevelChanged);
+    connect(verticalZoomSlider, &QSlider::valueChanged, this, &SpectrogramControls::verticalZoomLevelChanged);
+    connect(aggregationComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &SpectrogramControls::aggregationSettingChanged);
+    connect(aggregationPercentileSpinBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &SpectrogramControls::aggregationSettingChanged);
     connect(fileOpenButton, &QPushButton::clicked, this, &SpectrogramControls::fileOpenButtonClicked);
     connect(cursorsCheckBox, &QCheckBox::stateChanged, this, &SpectrogramControls::cursorsStateChanged);
+    connect(pyramidCheckBox, &QCheckBox::stateChanged, this, &SpectrogramControls::pyramidStateChanged);
     connect(powerMinSlider, &QSlider::valueChanged, this, &SpectrogramControls::powerMinChanged);
     connect(powerMaxSlider, &QSlider::valueChanged, this, &SpectrogramControls::powerMaxChanged);
     connect(squelchSlider, &QSlider::valueChanged, this, &SpectrogramControls::squelchChanged);
     connect(closeFMDemodButton, &QPushButton::clicked, this, &SpectrogramControls::closeFMDemodClicked);
+    connect(cacheMemorySpinBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &SpectrogramControls::cacheMemoryChanged);
+    connect(cacheStatsTimer, &QTimer::timeout, this, &SpectrogramControls::updateCacheStats);
+    cacheStatsTimer->start();
 }
 
 void SpectrogramControls::clearCursorLabels()
@@ -220,6 +278,36 @@ void SpectrogramControls::cursorsStateChanged(int state)
     }
 }
 
+void SpectrogramControls::pyramidStateChanged(int state)
+{
+    QSettings settings;
+    settings.setValue("BuildPyramid", state == Qt::Checked);
+}
+
+void SpectrogramControls::cacheMemoryChanged(int value)
+{
+    QSettings settings;
+    settings.setValue("CacheMemoryMB", value);
+    CacheBudget::instance().setTotal(qint64(value) << 20);
+}
+
+void SpectrogramControls::updateCacheStats()
+{
+    QStringList lines;
+    for (auto &usage : CacheBudget::instance().usage()) {
+        auto &stats = usage.stats;
+        auto lookups = stats.hits + stats.misses;
+        int hitRate = lookups > 0 ? int(100 * stats.hits / lookups) : 0;
+        lines << tr("%1: %2/%3 MB, %4% hits, %5 evicted")
+            .arg(usage.name)
+            .arg(stats.bytes >> 20)
+            .arg(stats.limit >> 20)
+            .arg(hitRate)
+            .arg(stats.evictions);
+    }
+    cacheStatsLabel->setText(lines.join("\n"));
+}
+
 void SpectrogramControls::setDefaults()
 {
     fftOrZoomChanged();
@@ -247,8 +335,17 @@ void SpectrogramControls::setDefaults()
     squelchSlider->setValue(settings.value("Squelch", 0).toInt());
     int zoomLevelValue = settings.value("ZoomLevel", 0).toInt();
     zoomLevelSlider->setValue(zoomLevelValue);
-    int zoomLevel = pow(2, zoomLevelValue);
-    zoomLevelValueLabel->setText(QString("[%1]").arg(zoomLevel));
+    updateZoomLevelLabel(zoomLevelValue);
+    int verticalZoomValue = settings.value("VerticalZoom", 0).toInt();
+    verticalZoomSlider->setValue(verticalZoomValue);
+    verticalZoomLevelChanged(verticalZoomValue);
+    int aggregation = settings.value("Aggregation", SpectrogramPlot::Mean).toInt();
+    int aggregationPercentile = settings.value("AggregationPercentile", 90).toInt();
+    aggregationComboBox->setCurrentIndex(aggregation);
+    aggregationPercentileSpinBox->setValue(aggregationPercentile);
+    aggregationSettingChanged();
+    cacheMemorySpinBox->setValue(CacheBudget::instance().total() >> 20);
+    pyramidCheckBox->setCheckState(settings.value("BuildPyramid", false).toBool() ? Qt::Checked : Qt::Unchecked);
 
     int savedFreq = settings.value("CenterFrequency", 0).toInt();
     centerFrequency->setText(QString::number(savedFreq));
@@ -257,8 +354,31 @@ void SpectrogramControls::setDefaults()
 void SpectrogramControls::fftOrZoomChanged(void)
 {
     int fftSize = pow(2, fftSizeSlider->value());
-    int zoomLevel = std::min(fftSize, (int)pow(2, zoomLevelSlider->value()));
-    emit fftOrZoomChanged(fftSize, zoomLevel);
+    int value = zoomLevelSlider->value();
+    int zoomLevel = std::min(fftSize, (int)pow(2, std::max(0, value)));
+    int fftsPerColumn = pow(2, std::max(0, -value));
+    emit fftOrZoomChanged(fftSize, zoomLevel, fftsPerColumn);
+}
+
+void SpectrogramControls::updateZoomLevelLabel(int value)
+{
+    if (value < 0)
+        zoomLevelValueLabel->setText(QString("[1/%1]").arg((int)pow(2, -value)));
+    else
+        zoomLevelValueLabel->setText(QString("[%1]").arg((int)pow(2, value)));
+
+    bool zoomedOut = value < 0;
+    aggregationComboBox->setEnabled(zoomedOut);
+    aggregationPercentileSpinBox->setEnabled(zoomedOut && aggregationComboBox->currentIndex() == SpectrogramPlot::Percentile);
+}
+
+void SpectrogramControls::aggregationSettingChanged()
+{
+    QSettings settings;
+    settings.setValue("Aggregation", aggregationComboBox->currentIndex());
+    settings.setValue("AggregationPercentile", aggregationPercentileSpinBox->value());
+    updateZoomLevelLabel(zoomLevelSlider->value());
+    emit aggregationChanged(aggregationComboBox->currentIndex(), aggregationPercentileSpinBox->value());
 }
 
 void SpectrogramControls::fftSizeChanged(int value)
@@ -274,11 +394,19 @@ void SpectrogramControls::zoomLevelChanged(int value)
 {
     QSettings settings;
     settings.setValue("ZoomLevel", value);
-    int zoomLevel = pow(2, value);
-    zoomLevelValueLabel->setText(QString("[%1]").arg(zoomLevel));
+    updateZoomLevelLabel(value);
     fftOrZoomChanged();
 }
 
+void SpectrogramControls::verticalZoomLevelChanged(int value)
+{
+    QSettings settings;
+    settings.setValue("VerticalZoom", value);
+    int factor = pow(2, value);
+    verticalZoomValueLabel->setText(QString("[%1x]").arg(factor));
+    emit verticalZoomChanged(factor);
+}
+
 void SpectrogramControls::powerMinChanged(int value)
 {
     QSettings settings;
@@ -391,10 +519,15 @@ void SpectrogramControls::tunerMoved(int deviation)
 
 int SpectrogramControls::getBandwidth(int deviation) {
     double rate = sampleRate->text().toDouble();
-    double fftSize = pow(2, fftSizeSlider->value());
-    double hzPerPx = rate / fftSize;
+    int rows = (displayRows > 0) ? displayRows : pow(2, fftSizeSlider->value());
+    double hzPerPx = rate / rows;
     return deviation * hzPerPx / 1000 * 2;
 }
+
+void SpectrogramControls::setDisplayRows(int rows)
+{
+    displayRows = rows;
+}
 void SpectrogramControls::enableAnnotations(bool enabled) {
     // disable annotation comments checkbox when annotations are disabled
     commentsCheckBox->setEnabled(enabled);
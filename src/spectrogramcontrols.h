@@ -26,7 +26,9 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QLabel>
+#include <QTimer>
 #include "tuner.h"
 
 class SpectrogramControls : public QDockWidget
@@ -38,7 +40,9 @@ public:
     void setDefaults();
 
 signals:
-    void fftOrZoomChanged(int fftSize, int zoomLevel);
+    void fftOrZoomChanged(int fftSize, int zoomLevel, int fftsPerColumn);
+    void aggregationChanged(int aggregation, int percentile);
+    void verticalZoomChanged(int factor);
     void openFile(QString fileName);
     void closeFMDemod();
 
@@ -49,16 +53,22 @@ public slots:
     void tunerMoved(int deviation);
     void enableAnnotations(bool enabled);
     void coordinateClick(double time_pos, double freq_pos, bool down);
+    void setDisplayRows(int rows);
 
 
 private slots:
     void fftSizeChanged(int value);
     void zoomLevelChanged(int value);
+    void verticalZoomLevelChanged(int value);
     void powerMinChanged(int value);
     void powerMaxChanged(int value);
     void squelchChanged(int value);
+    void aggregationSettingChanged();
     void fileOpenButtonClicked();
     void cursorsStateChanged(int state);
+    void pyramidStateChanged(int state);
+    void cacheMemoryChanged(int value);
+    void updateCacheStats();
     void closeFMDemodClicked();
 
 private:
@@ -66,7 +76,9 @@ private:
     QFormLayout *layout;
     void clearCursorLabels();
     void fftOrZoomChanged(void);
+    void updateZoomLevelLabel(int value);
     int getBandwidth(int deviation);
+    int displayRows = 0;
 
 public:
     QPushButton *fileOpenButton;
@@ -74,9 +86,13 @@ public:
     QLineEdit *centerFrequency;
     QSlider *fftSizeSlider;
     QSlider *zoomLevelSlider;
+    QSlider *verticalZoomSlider;
     QSlider *powerMaxSlider;
     QSlider *powerMinSlider;
     QSlider *squelchSlider;
+    QComboBox *aggregationComboBox;
+    QSpinBox *aggregationPercentileSpinBox;
+    QCheckBox *pyramidCheckBox;
     QCheckBox *cursorsCheckBox;
     QSpinBox *cursorSymbolsSpinBox;
     QCheckBox *cursorsFreezeCheckBox;
@@ -90,6 +106,8 @@ public:
     QLabel *fftSizeValueLabel;
     QLabel *zoomLevelLabel;
     QLabel *zoomLevelValueLabel;
+    QLabel *verticalZoomLabel;
+    QLabel *verticalZoomValueLabel;
     QLabel *powerMaxLabel;
     QLabel *powerMaxValueLabel;
     QLabel *powerMinLabel;
@@ -105,4 +123,8 @@ public:
     QCheckBox *scalesCheckBox;
     QCheckBox *annosCheckBox;
     QCheckBox *commentsCheckBox;
+
+    QSpinBox *cacheMemorySpinBox;
+    QLabel *cacheStatsLabel;
+    QTimer *cacheStatsTimer;
 };
@@ -23,13 +23,18 @@
 #include <QElapsedTimer>
 #include <QPainter>
 #include <QPaintEvent>
-#include <QPixmapCache>
 #include <QRect>
 #include <liquid/liquid.h>
 #include <algorithm>
 #include <functional>
 #include <cstdlib>
 #include <limits>
+#include <numeric>
+#include <QtConcurrent>
+#include "framescheduler.h"
+#include "kernels.h"
+#include "tilediskcache.h"
+#include "traceplot.h"
 #include "util.h"
 
 
@@ -50,9 +55,18 @@ SpectrogramPlot::SpectrogramPlot(std::shared_ptr<SampleSource<std::complex<float
         float p = (float)i / 256;
         colormap[i] = QColor::fromHsvF(p * 0.83f, 1.0, 1.0 - p).rgba();
     }
+    updateColorTable();
 
     tunerTransform = std::make_shared<TunerTransform>(src);
 //    connect(&tuner, &Tuner::tunerMoved, this, &SpectrogramPlot::tunerMoved);
+    connect(this, &SpectrogramPlot::tileReady, this, &SpectrogramPlot::handleTile);
+    connect(this, &SpectrogramPlot::tileRecolored, this, &SpectrogramPlot::handleRecolor);
+}
+
+SpectrogramPlot::~SpectrogramPlot()
+{
+    stopPyramid();
+    cancelTiles();
 }
 
 void SpectrogramPlot::invalidateEvent()
@@ -60,8 +74,11 @@ void SpectrogramPlot::invalidateEvent()
     // HACK: this makes sure we update the height for real signals (as InputSource is passed here before the file is opened)
     setFFTSize(fftSize);
 
-    pixmapCache.clear();
-    fftCache.clear();
+    resetPixmapTiles();
+    {
+        QMutexLocker ml(&fftCacheMutex);
+        fftCache.clear();
+    }
     emit repaint();
 }
 
@@ -254,114 +271,860 @@ void SpectrogramPlot::paintMid(QPainter &painter, QRect &rect, range_t<size_t> s
     size_t sampleOffset = sampleRange.minimum % (getStride() * linesPerTile());
     size_t tileID = sampleRange.minimum - sampleOffset;
     int xoffset = sampleOffset / getStride();
+    QSet<TileCacheKey> visible;
+
+    // Tiles that aren't ready yet are drawn from other zoom levels where
+    // possible (otherwise in the lowest power colour) and replaced as
+    // their requests complete
+    auto drawTile = [&](const QRect &target, size_t tile, const QRect &source) {
+        auto pixmap = getPixmapTile(tile, visible);
+        if (!pixmap.isNull()) {
+            painter.drawPixmap(target, pixmap, source);
+        } else {
+            painter.fillRect(target, QColor::fromRgba(colormap[255]));
+            paintFallback(painter, target, tile + source.x() * getStride());
+        }
+    };
 
     // Paint first (possibly partial) tile
-    painter.drawPixmap(QRect(rect.left(), rect.y(), linesPerTile() - xoffset, height()), *getPixmapTile(tileID), QRect(xoffset, 0, linesPerTile() - xoffset, height()));
+    drawTile(QRect(rect.left(), rect.y(), linesPerTile() - xoffset, height()), tileID, QRect(xoffset, 0, linesPerTile() - xoffset, height()));
     tileID += getStride() * linesPerTile();
 
     // Paint remaining tiles
     for (int x = linesPerTile() - xoffset; x < rect.right(); x += linesPerTile()) {
         // TODO: don't draw past rect.right()
         // TODO: handle partial final tile
-        painter.drawPixmap(QRect(x, rect.y(), linesPerTile(), height()), *getPixmapTile(tileID), QRect(0, 0, linesPerTile(), height()));
+        drawTile(QRect(x, rect.y(), linesPerTile(), height()), tileID, QRect(0, 0, linesPerTile(), height()));
         tileID += getStride() * linesPerTile();
     }
+
+    // Anything still pending that is no longer on screen isn't worth finishing
+    for (auto requests : {&tileRequests, &recolorRequests}) {
+        for (auto it = requests->begin(); it != requests->end();) {
+            if (!visible.contains(it.key())) {
+                retired.add(it.value());
+                it = requests->erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void SpectrogramPlot::paintFallback(QPainter &painter, const QRect &target, size_t sample)
+{
+    // Farther levels go first so the nearest ones end up on top
+    size_t stride = getStride();
+    size_t end = sample + target.width() * stride;
+    for (int distance = maxFallbackLevels; distance > 0; distance--) {
+        for (size_t altStride : {stride << distance, stride >> distance}) {
+            int zoom, ffts;
+            if (altStride == 0 || !zoomForStride(altStride, zoom, ffts))
+                continue;
+
+            size_t tileSamples = altStride * linesPerTile();
+            for (size_t tile = sample - sample % tileSamples; tile < end; tile += tileSamples) {
+                // Scaled stand-ins are the first thing to go when a
+                // frame runs long; the next frame picks them up
+                if (!FrameScheduler::instance().hasBudget()) {
+                    FrameScheduler::instance().defer();
+                    return;
+                }
+
+                ColoredTile colored;
+                if (!pixmapCache.peek(TileCacheKey(fftSize, displayRows(), zoom, ffts, tile), &colored))
+                    continue;
+                const QPixmap &pixmap = colored.pixmap;
+
+                size_t from = std::max(tile, sample);
+                size_t to = std::min(tile + tileSamples, end);
+                QRectF dest(target.x() + double(from - sample) / stride, target.y(),
+                            double(to - from) / stride, target.height());
+                QRectF source(double(from - tile) / altStride, 0,
+                              double(to - from) / altStride, pixmap.height());
+                painter.drawPixmap(dest, pixmap, source);
+            }
+        }
+    }
+}
+
+QPixmap SpectrogramPlot::getPixmapTile(size_t tile, QSet<TileCacheKey> &visible)
+{
+    TileCacheKey key(fftSize, displayRows(), zoomLevel, fftsPerColumn, tile);
+    ColoredTile colored;
+    bool found = pixmapCache.find(key, &colored);
+    if (found && colored.colorGeneration == colorGeneration)
+        return colored.pixmap;
+
+    // Out of date colours are shown until the pool has redone them
+    visible.insert(key);
+    std::shared_ptr<const std::vector<int16_t>> fftTile;
+    if (fftCache.find(key, &fftTile)) {
+        if (!recolorRequests.contains(key))
+            recolorRequests.insert(key, requestRecolor(key, fftTile));
+        return found ? colored.pixmap : QPixmap();
+    }
+    if (tileRequests.contains(key))
+        return found ? colored.pixmap : QPixmap();
+
+    // A prefetch that's already running is left to finish, otherwise
+    // it's requeued at visible priority
+    auto prefetched = prefetchRequests.take(key);
+    if (prefetched && prefetched->isStarted()) {
+        tileRequests.insert(key, prefetched);
+    } else {
+        if (prefetched)
+            retired.add(prefetched);
+        tileRequests.insert(key, requestTile(tile, zoomLevel, fftsPerColumn, AsyncRequest::Visible));
+    }
+    return found ? colored.pixmap : QPixmap();
+}
+
+std::shared_ptr<AsyncRequest> SpectrogramPlot::requestRecolor(const TileCacheKey &key,
+                                                              std::shared_ptr<const std::vector<int16_t>> fftTile)
+{
+    quint64 generation = tileGeneration;
+    quint64 colorGeneration = this->colorGeneration;
+    auto colorTable = this->colorTable;
+    int rows = height();
+
+    return AsyncRequest::run([=](AsyncRequest &request) {
+        auto colored = colorizeTile(*fftTile, key.rows, rows, *colorTable);
+        emit tileRecolored(generation, colorGeneration, key.fftSize, key.zoomLevel, key.fftsPerColumn, key.sample, colored);
+    }, AsyncRequest::Visible);
+}
+
+void SpectrogramPlot::prefetch(const std::vector<PrefetchRegion> &regions)
+{
+    if (!inputSource || inputSource->count() == 0)
+        return;
+
+    QSet<TileCacheKey> wanted;
+    for (auto &region : regions) {
+        int zoom, ffts;
+        if (!zoomForStride(region.samplesPerColumn, zoom, ffts))
+            continue;
+
+        size_t tileSamples = getStride(fftSize, zoom, ffts) * linesPerTile();
+        size_t end = std::min(region.sampleRange.maximum, inputSource->count());
+        size_t tile = region.sampleRange.minimum - region.sampleRange.minimum % tileSamples;
+        for (; tile < end; tile += tileSamples) {
+            TileCacheKey key(fftSize, displayRows(), zoom, ffts, tile);
+            if (tileRequests.contains(key) || fftCache.contains(key))
+                continue;
+            wanted.insert(key);
+            if (!prefetchRequests.contains(key))
+                prefetchRequests.insert(key, requestTile(tile, zoom, ffts, AsyncRequest::Prefetch));
+        }
+    }
+
+    for (auto it = prefetchRequests.begin(); it != prefetchRequests.end();) {
+        if (!wanted.contains(it.key())) {
+            retired.add(it.value());
+            it = prefetchRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SpectrogramPlot::zoomForStride(size_t stride, int &zoom, int &ffts)
+{
+    // Only the zoom levels the controls can select are worth fetching
+    auto powerOfTwo = [](size_t n) { return n > 0 && (n & (n - 1)) == 0; };
+    if (stride >= size_t(fftSize)) {
+        zoom = 1;
+        ffts = stride / fftSize;
+        return powerOfTwo(ffts) && ffts <= (1 << SpectrogramPyramid::maxLevel);
+    }
+    zoom = fftSize / stride;
+    ffts = 1;
+    return powerOfTwo(zoom);
+}
+
+std::shared_ptr<AsyncRequest> SpectrogramPlot::requestTile(size_t tile, int zoomLevel, int fftsPerColumn, int priority)
+{
+    TileParams params;
+    params.generation = tileGeneration;
+    params.fftSize = fftSize;
+    params.zoomLevel = zoomLevel;
+    params.fftsPerColumn = fftsPerColumn;
+    params.aggregation = aggregation;
+    params.percentile = aggregationPercentile;
+    params.real = inputSource->realSignal();
+    params.displayRows = displayRows();
+    params.rows = height();
+    params.window = window;
+    params.pyramid = pyramid;
+    params.identity = sourceIdentity;
+    quint64 colorGeneration = this->colorGeneration;
+    auto colorTable = this->colorTable;
+
+    return AsyncRequest::run([=](AsyncRequest &request) {
+        auto fftTile = getFFTTile(params, tile, request);
+        if (fftTile == nullptr)
+            return;
+        auto colored = colorizeTile(*fftTile, params.displayRows, params.rows, *colorTable);
+        emit tileReady(params.generation, params.fftSize, params.zoomLevel, params.fftsPerColumn, tile, colorGeneration, colored);
+    }, priority);
+}
+
+void SpectrogramPlot::handleTile(quint64 generation, int fftSize, int zoomLevel, int fftsPerColumn, quint64 tile,
+                                 quint64 colorGeneration, QImage colored)
+{
+    TileCacheKey key(fftSize, displayRows(), zoomLevel, fftsPerColumn, tile);
+    if (generation != tileGeneration)
+        return;
+
+    tileRequests.remove(key);
+    prefetchRequests.remove(key);
+    insertPixmap(key, colored, colorGeneration);
+    emit repaint();
+}
+
+void SpectrogramPlot::handleRecolor(quint64 generation, quint64 colorGeneration, int fftSize, int zoomLevel,
+                                    int fftsPerColumn, quint64 tile, QImage colored)
+{
+    TileCacheKey key(fftSize, displayRows(), zoomLevel, fftsPerColumn, tile);
+    if (generation != tileGeneration)
+        return;
+
+    // Requests for older colours were dropped from the hash when the
+    // colours changed, but their results are still nearer than nothing
+    if (colorGeneration == this->colorGeneration)
+        recolorRequests.remove(key);
+    insertPixmap(key, colored, colorGeneration);
+    emit repaint();
+}
+
+void SpectrogramPlot::cancelTiles()
+{
+    for (auto requests : {&tileRequests, &prefetchRequests, &recolorRequests}) {
+        for (auto &request : *requests)
+            retired.add(request);
+        requests->clear();
+    }
+    // Jobs dropped earlier may still be running against us too
+    retired.waitForFinished();
+}
+
+void SpectrogramPlot::retireTileRequests()
+{
+    // Requests already running finish in the background, but their
+    // results no longer match the new generation and are dropped
+    tileGeneration++;
+    for (auto requests : {&tileRequests, &prefetchRequests, &recolorRequests}) {
+        for (auto &request : *requests)
+            retired.add(request);
+        requests->clear();
+    }
+}
+
+void SpectrogramPlot::resetPixmapTiles()
+{
+    retireTileRequests();
+    pixmapCache.clear();
+}
+
+void SpectrogramPlot::updateColorTable()
+{
+    // Built over the current power range, so all of the colour map is used
+    auto table = std::make_shared<std::vector<QRgb>>(65536);
+    centiDbColorTable(powerMin, powerMax, colormap, table->data());
+    colorTable = table;
+
+    // Cached pixmaps keep being drawn until their tiles are recoloured
+    colorGeneration++;
+    for (auto &request : recolorRequests)
+        retired.add(request);
+    recolorRequests.clear();
+}
+
+QImage SpectrogramPlot::colorizeTile(const std::vector<int16_t> &fftTile, int tileRows, int rows,
+                                     const std::vector<QRgb> &colorTable)
+{
+    // Only the top rows rows are shown (the positive half for real
+    // signals), highest frequency first
+    int lines = fftTile.size() / tileRows;
+    QImage image(lines, rows, QImage::Format_RGB32);
+    for (int y = tileRows - rows; y < tileRows; y++) {
+        auto scanLine = reinterpret_cast<QRgb*>(image.scanLine(tileRows - y - 1));
+        colorizeCentiDb(&fftTile[y], tileRows, colorTable.data(), scanLine, lines);
+    }
+    return image;
+}
+
+void SpectrogramPlot::insertPixmap(const TileCacheKey &key, const QImage &colored, quint64 colorGeneration)
+{
+    // Don't replace newer colours with older ones
+    ColoredTile existing;
+    if (pixmapCache.peek(key, &existing) && existing.colorGeneration > colorGeneration)
+        return;
+    ColoredTile tile{QPixmap::fromImage(colored), colorGeneration};
+    pixmapCache.insert(key, tile, qint64(colored.bytesPerLine()) * colored.height());
+}
+
+FFT& SpectrogramPlot::prepareFFT(FFTState &state, int fftSize, int batch, bool real)
+{
+    if (!state.fft || state.fft->getSize() != fftSize || state.fft->getBatch() != batch || state.fft->isReal() != real)
+        state.fft.reset(new FFT(fftSize, batch, real));
+    return *state.fft;
+}
+
+std::shared_ptr<const std::vector<int16_t>> SpectrogramPlot::getFFTTile(const TileParams &params, size_t tile, AsyncRequest &request)
+{
+    TileCacheKey key(params.fftSize, params.displayRows, params.zoomLevel, params.fftsPerColumn, tile);
+    std::shared_ptr<const std::vector<int16_t>> cached;
+    if (fftCache.find(key, &cached))
+        return cached;
+
+    if (request.isCancelled())
+        return nullptr;
+
+    // Then whatever an earlier session left on disk
+    int lines = linesPerTile(params.displayRows);
+    int rows = params.displayRows;
+    auto name = diskTileName(params, tile);
+    std::shared_ptr<const std::vector<int16_t>> destStorage = TileDiskCache::instance().load(params.identity, name, lines * rows);
+    if (destStorage == nullptr) {
+        auto computed = computeFFTTile(params, tile, request);
+        if (computed == nullptr)
+            return nullptr;
+        auto compact = std::make_shared<std::vector<int16_t>>(computed->size());
+        encodeCentiDb(computed->data(), compact->data(), computed->size());
+        TileDiskCache::instance().store(params.identity, name, *compact);
+        destStorage = compact;
+    }
+
+    // Checked and inserted under the lock so a concurrent reset can't
+    // be undone by a tile computed with the old settings
+    QMutexLocker ml(&fftCacheMutex);
+    if (params.generation == tileGeneration)
+        fftCache.insert(key, destStorage, destStorage->size() * sizeof(int16_t));
+    return destStorage;
 }
 
-QPixmap* SpectrogramPlot::getPixmapTile(size_t tile)
+QString SpectrogramPlot::diskTileName(const TileParams &params, size_t tile)
 {
-    QPixmap *obj = pixmapCache.object(TileCacheKey(fftSize, zoomLevel, tile));
-    if (obj != 0)
-        return obj;
+    auto name = QString("%1-%2-%3-%4").arg(params.fftSize).arg(params.zoomLevel).arg(params.fftsPerColumn).arg(tile);
+    if (params.displayRows != params.fftSize)
+        name += QString("-r%1").arg(params.displayRows);
+    if (params.fftsPerColumn > 1) {
+        if (params.aggregation == Mean)
+            name += "-mean";
+        else if (params.aggregation == Max)
+            name += "-max";
+        else
+            name += QString("-p%1").arg(params.percentile);
+    }
+    return name;
+}
 
-    float *fftTile = getFFTTile(tile);
-    obj = new QPixmap(linesPerTile(), fftSize);
-    QImage image(linesPerTile(), fftSize, QImage::Format_RGB32);
-    float powerRange = -1.0f / std::abs(int(powerMin - powerMax));
-    for (int y = 0; y < fftSize; y++) {
-        auto scanLine = (QRgb*)image.scanLine(fftSize - y - 1);
-        for (int x = 0; x < linesPerTile(); x++) {
-            float *fftLine = &fftTile[x * fftSize];
-            float normPower = (fftLine[y] - powerMax) * powerRange;
-            normPower = clamp(normPower, 0.0f, 1.0f);
+std::shared_ptr<std::vector<float>> SpectrogramPlot::computeFFTTile(const TileParams &params, size_t tile, AsyncRequest &request)
+{
+    int lines = linesPerTile(params.displayRows);
+    int rows = params.displayRows;
+    size_t stride = getStride(params.fftSize, params.zoomLevel, params.fftsPerColumn);
+    auto destStorage = std::make_shared<std::vector<float>>(lines * rows);
+
+    if (params.fftsPerColumn > 1) {
+        // Every column is a reduction over many FFTs, so spread the
+        // columns of the tile across the pool
+        std::vector<int> columns(lines);
+        std::iota(columns.begin(), columns.end(), 0);
+        QtConcurrent::blockingMap(columns, [&](int column) {
+            if (request.isCancelled())
+                return;
+            auto state = fftStates.acquire();
+            int batch = std::min(params.fftsPerColumn, batchSize(params.fftSize));
+            auto &fft = prepareFFT(*state, params.fftSize, batch, params.real);
+            float *dest = &(*destStorage)[column * rows];
+            if (!getPyramidLine(dest, tile + column * stride, params))
+                getAggregatedLine(dest, tile + column * stride, params, fft, state->histogram);
+        });
+        if (request.isCancelled())
+            return nullptr;
+    } else {
+        std::vector<bool> filled(lines, false);
+        reuseLines(destStorage->data(), params, tile, filled);
+        std::vector<int> missing;
+        for (int line = 0; line < lines; line++) {
+            if (!filled[line])
+                missing.push_back(line);
+        }
 
-            scanLine[x] = colormap[(uint8_t)(normPower * (256 - 1))];
+        auto state = fftStates.acquire();
+        int batch = std::min(lines, batchSize(params.fftSize));
+        auto &fft = prepareFFT(*state, params.fftSize, batch, params.real);
+
+        // What's left after reuse is usually every other line, so compute
+        // evenly spaced runs of missing lines in one go each
+        std::vector<float> scratch;
+        for (size_t first = 0; first < missing.size();) {
+            int step = (first + 1 < missing.size()) ? missing[first + 1] - missing[first] : 1;
+            size_t count = 1;
+            while (first + count < missing.size() && missing[first + count] - missing[first + count - 1] == step)
+                count++;
+
+            float *dest = destStorage->data() + missing[first] * rows;
+            if (step == 1) {
+                getTile(dest, tile + missing[first] * stride, count, stride, params.window->data(), fft, rows);
+            } else {
+                scratch.resize(count * rows);
+                getTile(scratch.data(), tile + missing[first] * stride, count, stride * step, params.window->data(), fft, rows);
+                for (size_t i = 0; i < count; i++)
+                    std::copy_n(&scratch[i * rows], rows, dest + i * step * rows);
+            }
+            first += count;
+
+            if (request.isCancelled())
+                return nullptr;
         }
     }
-    obj->convertFromImage(image);
-    pixmapCache.insert(TileCacheKey(fftSize, zoomLevel, tile), obj);
-    return obj;
+    return destStorage;
 }
 
-float* SpectrogramPlot::getFFTTile(size_t tile)
+int SpectrogramPlot::reuseLines(float *dest, const TileParams &params, size_t tile, std::vector<bool> &filled)
 {
-    std::array<float, tileSize>* obj = fftCache.object(TileCacheKey(fftSize, zoomLevel, tile));
-    if (obj != nullptr)
-        return obj->data();
+    // A line only depends on the FFT size and the sample it starts at, so
+    // any line of this tile that another zoom level has already computed
+    // can be copied out of that level's cached tile
+    const int lines = linesPerTile(params.displayRows);
+    const int rows = params.displayRows;
+    const size_t stride = getStride(params.fftSize, params.zoomLevel, 1);
+    const size_t tileEnd = tile + lines * stride;
+    int reused = 0;
+
+    // Nearest levels first, as they share the most lines with this one
+    std::vector<int> zooms;
+    for (int distance = 1; distance <= maxReuseLevels; distance++) {
+        if ((params.zoomLevel << distance) <= params.fftSize)
+            zooms.push_back(params.zoomLevel << distance);
+        if ((params.zoomLevel >> distance) >= 1)
+            zooms.push_back(params.zoomLevel >> distance);
+    }
 
-    std::array<float, tileSize>* destStorage = new std::array<float, tileSize>;
-    float *ptr = destStorage->data();
-    size_t sample = tile;
-    while ((ptr - destStorage->data()) < tileSize) {
-        getLine(ptr, sample);
-        sample += getStride();
-        ptr += fftSize;
+    for (int zoom : zooms) {
+        if (reused == lines)
+            break;
+
+        size_t otherStride = getStride(params.fftSize, zoom, 1);
+        size_t otherTileSamples = otherStride * lines;
+        for (size_t otherTile = tile - tile % otherTileSamples; otherTile < tileEnd; otherTile += otherTileSamples) {
+            std::shared_ptr<const std::vector<int16_t>> other;
+            if (!fftCache.peek(TileCacheKey(params.fftSize, params.displayRows, zoom, 1, otherTile), &other))
+                continue;
+
+            size_t from = std::max(tile, otherTile);
+            size_t to = std::min(tileEnd, otherTile + otherTileSamples);
+            for (size_t line = (from - tile + stride - 1) / stride; tile + line * stride < to; line++) {
+                size_t offset = tile + line * stride - otherTile;
+                if (filled[line] || offset % otherStride != 0)
+                    continue;
+                decodeCentiDb(&(*other)[(offset / otherStride) * rows], dest + line * rows, rows);
+                filled[line] = true;
+                reused++;
+            }
+        }
     }
-    fftCache.insert(TileCacheKey(fftSize, zoomLevel, tile), destStorage);
-    return destStorage->data();
+    return reused;
 }
 
-void SpectrogramPlot::getLine(float *dest, size_t sample)
+void SpectrogramPlot::getTile(float *dest, size_t tile, int lines, size_t stride, const float *window, FFT &fft, int rows)
 {
-    if (inputSource && fft) {
-        // Make sample be the midpoint of the FFT, unless this takes us
-        // past the beginning of the inputSource (if we remove the
-        // std::max(·, 0), then an ugly red bar appears at the beginning
-        // of the spectrogram with large zooms and FFT sizes).
-        const auto first_sample = std::max(static_cast<ssize_t>(sample) - fftSize / 2,
+    // Sliding lines don't go through the FFT buffer, so they aren't
+    // limited to a batch at a time
+    if (useSlidingDFT(fft.getSize(), stride) && tile >= size_t(fft.getSize() / 2)) {
+        getLines(dest, tile, lines, stride, window, fft, rows);
+        return;
+    }
+
+    // Large FFTs are run a few lines at a time so the sample span and
+    // FFT buffer stay bounded however big the transform is
+    for (int first = 0; first < lines; first += fft.getBatch()) {
+        int count = std::min(fft.getBatch(), lines - first);
+        getLines(&dest[first * rows], tile + first * stride, count, stride, window, fft, rows);
+    }
+}
+
+void SpectrogramPlot::getAggregatedLine(float *dest, size_t sample, const TileParams &params, FFT &fft,
+                                        std::vector<uint16_t> &histogram)
+{
+    const int fftSize = params.fftSize;
+    const int rows = params.displayRows;
+    const int batch = fft.getBatch();
+    const float logMultiplier = 10.0f / log2f(10.0f);
+
+    // Percentiles come from a per-row histogram of the dB values, so
+    // memory doesn't grow with the number of FFTs in the column. Counts
+    // are 16 bit and saturate; the percentile is taken over what was
+    // counted, in totals
+    const float histogramMin = -200.0f;
+    const float histogramStep = 0.5f;
+    const int histogramBins = 500;
+
+    bool percentile = (params.aggregation == Percentile);
+    std::vector<float> lines(batch * rows);
+    std::vector<double> sums;
+    std::vector<float> peaks;
+    std::vector<uint32_t> totals;
+    if (params.aggregation == Mean) {
+        sums.resize(rows, 0.0);
+    } else if (params.aggregation == Max) {
+        peaks.resize(rows, 0.0f);
+    } else {
+        histogram.assign(rows * histogramBins, 0);
+        totals.resize(rows, 0);
+    }
+
+    int counted = 0;
+    for (int first = 0; first < params.fftsPerColumn; first += batch) {
+        int count = std::min(batch, params.fftsPerColumn - first);
+        int valid = getLines(lines.data(), sample + first * fftSize, count, fftSize, params.window->data(), fft, rows, !percentile);
+        for (int line = 0; line < valid; line++) {
+            const float *values = &lines[line * rows];
+            for (int row = 0; row < rows; row++) {
+                if (params.aggregation == Mean) {
+                    sums[row] += values[row];
+                } else if (params.aggregation == Max) {
+                    peaks[row] = std::max(peaks[row], values[row]);
+                } else {
+                    int bin = clamp(int((values[row] - histogramMin) / histogramStep), 0, histogramBins - 1);
+                    uint16_t &count = histogram[row * histogramBins + bin];
+                    if (count != UINT16_MAX) {
+                        count++;
+                        totals[row]++;
+                    }
+                }
+            }
+        }
+        counted += valid;
+    }
+
+    if (counted == 0) {
+        std::fill(dest, dest + rows, -1 * std::numeric_limits<float>::infinity());
+        return;
+    }
+
+    for (int row = 0; row < rows; row++) {
+        if (params.aggregation == Mean) {
+            dest[row] = log2f(sums[row] / counted) * logMultiplier;
+        } else if (params.aggregation == Max) {
+            dest[row] = log2f(peaks[row]) * logMultiplier;
+        } else {
+            uint32_t target = std::max(1u, uint32_t(ceilf(totals[row] * params.percentile / 100.0f)));
+            uint32_t total = 0;
+            int bin = 0;
+            const uint16_t *counts = &histogram[row * histogramBins];
+            while (bin < histogramBins - 1 && (total += counts[bin]) < target)
+                bin++;
+            dest[row] = histogramMin + (bin + 0.5f) * histogramStep;
+        }
+    }
+}
+
+bool SpectrogramPlot::getPyramidLine(float *dest, size_t sample, const TileParams &params)
+{
+    auto &pyramid = params.pyramid;
+    if (!pyramid || !pyramid->isComplete() || pyramid->fftSize() != params.fftSize)
+        return false;
+    if (params.aggregation == Percentile)
+        return false;
+
+    int level = 0;
+    while ((1 << level) < params.fftsPerColumn)
+        level++;
+    size_t samplesPerLine = size_t(params.fftSize) << level;
+    if (sample % samplesPerLine != 0)
+        return false;
+
+    auto statistic = (params.aggregation == Max) ? SpectrogramPyramid::Max : SpectrogramPyramid::Mean;
+    const float *line = pyramid->line(level, statistic, sample / samplesPerLine);
+    if (line == nullptr)
+        return false;
+
+    // Pooled down to the display rows the same way getLines does
+    int binsPerRow = pyramid->rows() / params.displayRows;
+    if (binsPerRow > 1) {
+        for (int row = 0; row < params.displayRows; row++)
+            dest[row] = *std::max_element(&line[row * binsPerRow], &line[(row + 1) * binsPerRow]);
+        line = dest;
+    }
+    powerDb(line, 0.0f, dest, params.displayRows);
+    return true;
+}
+
+void SpectrogramPlot::updatePyramid()
+{
+    auto &identity = sourceIdentity;
+    if (pyramid && pyramid->identity() == identity && pyramid->fftSize() == fftSize) {
+        if (pyramidEnabled && !pyramid->isComplete() && !pyramidRequest)
+            buildPyramid();
+        return;
+    }
+
+    stopPyramid();
+    pyramid.reset();
+    if (identity.isEmpty())
+        return;
+
+    // An existing sidecar is always used; a new one is only made on request
+    // Always at full resolution, so it serves any vertical zoom
+    pyramid = SpectrogramPyramid::open(inputSource->fileName(), identity, fftSize, fullRows(fftSize),
+                                       inputSource->count(), pyramidEnabled);
+    if (pyramid && pyramidEnabled && !pyramid->isComplete())
+        buildPyramid();
+}
+
+void SpectrogramPlot::buildPyramid()
+{
+    auto target = pyramid;
+    auto window = this->window;
+    bool real = inputSource->realSignal();
+
+    pyramidRequest = AsyncRequest::run([=](AsyncRequest &request) {
+        const int fftSize = target->fftSize();
+        const int rows = target->rows();
+        const int fftsPerLine = 1 << target->firstLevel();
+        const int batch = std::min(fftsPerLine, batchSize(fftSize));
+
+        auto state = fftStates.acquire();
+        auto &fft = prepareFFT(*state, fftSize, batch, real);
+        std::vector<float> lines(batch * rows);
+
+        size_t lineCount = target->lines(target->firstLevel());
+        for (size_t line = target->builtLines(); line < lineCount; line++) {
+            float *mean = target->firstLevelLine(SpectrogramPyramid::Mean, line);
+            float *max = target->firstLevelLine(SpectrogramPyramid::Max, line);
+            std::fill(mean, mean + rows, 0.0f);
+            std::fill(max, max + rows, 0.0f);
+
+            size_t sample = line * fftsPerLine * size_t(fftSize);
+            for (int first = 0; first < fftsPerLine; first += batch) {
+                if (request.isCancelled())
+                    return;
+                int valid = getLines(lines.data(), sample + first * fftSize, batch, fftSize, window->data(), fft, rows, true);
+                for (int i = 0; i < valid * rows; i++) {
+                    mean[i % rows] += lines[i];
+                    max[i % rows] = std::max(max[i % rows], lines[i]);
+                }
+            }
+            for (int row = 0; row < rows; row++)
+                mean[row] /= fftsPerLine;
+            target->setBuiltLines(line + 1);
+        }
+        target->finish();
+    }, AsyncRequest::Prefetch);
+}
+
+void SpectrogramPlot::stopPyramid()
+{
+    if (pyramidRequest) {
+        pyramidRequest->cancel();
+        pyramidRequest->waitForFinished();
+        pyramidRequest.reset();
+    }
+}
+
+int SpectrogramPlot::getLines(float *dest, size_t sample, int lines, size_t stride, const float *window, FFT &fft, int rows, bool linear)
+{
+    const int fftSize = fft.getSize();
+    const int binsPerRow = fftSize / rows;
+    const auto neg_infinity = -1 * std::numeric_limits<float>::infinity();
+
+    // Make sample be the midpoint of the FFT, unless this takes us
+    // past the beginning of the inputSource (if we remove the
+    // std::max(·, 0), then an ugly red bar appears at the beginning
+    // of the spectrogram with large zooms and FFT sizes).
+    auto lineStart = [&](int line) -> size_t {
+        return std::max(static_cast<ssize_t>(sample + line * stride) - fftSize / 2,
                         static_cast<ssize_t>(0));
-        auto buffer = inputSource->getSamples(first_sample, fftSize);
-        if (buffer == nullptr) {
-            auto neg_infinity = -1 * std::numeric_limits<float>::infinity();
-            for (int i = 0; i < fftSize; i++, dest++)
-                *dest = neg_infinity;
-            return;
+    };
+
+    // Lines that run off the end of the input are left at -inf
+    size_t spanStart = lineStart(0);
+    size_t spanEnd = std::min(lineStart(lines - 1) + fftSize, inputSource ? inputSource->count() : 0);
+    int validLines = 0;
+    while (validLines < lines && lineStart(validLines) + fftSize <= spanEnd)
+        validLines++;
+
+    // Power of each bin, scaled by 1 / fftSize^2 - in dB that is just an
+    // offset. Rows covering several bins keep the peak so narrow
+    // carriers survive the reduction; dB is monotonic, so taking the
+    // peak after the conversion gives the same answer
+    const float powerScale = 1.0f / (float(fftSize) * fftSize);
+    const float dbOffset = -20.0f * log10f(fftSize);
+    std::vector<float> bins(binsPerRow > 1 ? fftSize : 0);
+    auto reduceLine = [&](const std::complex<float> *out) {
+        // Start from the middle of the FFTW array and wrap to rearrange
+        // the data. A real transform only has the non-negative half,
+        // which is all that gets displayed
+        const int half = fftSize / 2;
+        float *shifted = (binsPerRow > 1) ? bins.data() : dest;
+        if (fft.isReal())
+            std::fill(shifted, shifted + half, linear ? 0.0f : neg_infinity);
+        else if (linear)
+            powerComplex(out + half, powerScale, shifted, half);
+        else
+            powerComplexDb(out + half, dbOffset, shifted, half);
+        if (linear)
+            powerComplex(out, powerScale, shifted + half, half);
+        else
+            powerComplexDb(out, dbOffset, shifted + half, half);
+
+        if (binsPerRow > 1) {
+            for (int row = 0; row < rows; row++)
+                dest[row] = *std::max_element(&bins[row * binsPerRow], &bins[(row + 1) * binsPerRow]);
         }
+        dest += rows;
+    };
+
+    // Closely spaced lines are cheaper to slide along the input than to
+    // transform one by one. Lines clamped to the start of the input
+    // aren't evenly spaced, so those always take the FFT path
+    auto input = dynamic_cast<InputSource*>(inputSource.get());
+    if (validLines > 1 && useSlidingDFT(fftSize, stride) && sample >= size_t(fftSize / 2)) {
+        // Integer recordings are read in their native width, real ones
+        // without a zero imaginary part
+        std::unique_ptr<float[]> realSamples;
+        std::unique_ptr<std::complex<int16_t>[]> integerSamples;
+        std::unique_ptr<std::complex<float>[]> samples;
+        if (input != nullptr && fft.isReal())
+            realSamples = input->getSamplesReal(spanStart, spanEnd - spanStart);
+        else if (input != nullptr)
+            integerSamples = input->getSamplesInt16(spanStart, spanEnd - spanStart);
+        if (realSamples == nullptr && integerSamples == nullptr && !fft.isReal())
+            samples = inputSource->getSamples(spanStart, spanEnd - spanStart);
+
+        if (realSamples != nullptr || integerSamples != nullptr || samples != nullptr) {
+            auto sampleAt = [&](size_t i) -> std::complex<double> {
+                if (realSamples != nullptr)
+                    return realSamples[i];
+                if (integerSamples != nullptr)
+                    return std::complex<double>(integerSamples[i].real(), integerSamples[i].imag()) * (1.0 / 32768.0);
+                return samples[i];
+            };
+            getSlidingLines(sampleAt, validLines, stride, fftSize, reduceLine);
+        } else {
+            validLines = 0;
+        }
+        std::fill(dest, dest + (lines - validLines) * rows, linear ? 0.0f : neg_infinity);
+        return validLines;
+    }
 
-        for (int i = 0; i < fftSize; i++) {
-            buffer[i] *= window[i];
+    // Recordings are converted and windowed by their sample adapter
+    // straight from the mapping into the FFT's own buffer, and the
+    // transform runs in place, so reduceLine reads its output directly.
+    // Other sources (e.g. materialized streams) still come through a
+    // buffer of their own
+    auto buffer = fft.buffer();
+    std::unique_ptr<std::complex<float>[]> samples;
+    if (input == nullptr && validLines > 0) {
+        samples = inputSource->getSamples(spanStart, spanEnd - spanStart);
+        if (samples == nullptr)
+            validLines = 0;
+    }
+    for (int line = 0; line < validLines; line++) {
+        if (input == nullptr) {
+            windowComplex(&samples[lineStart(line) - spanStart], window, &buffer[line * fftSize], fftSize);
+            continue;
         }
+        bool copied = fft.isReal()
+            ? input->getWindowedSamplesReal(lineStart(line), fftSize, window, &fft.realBuffer()[line * fft.realStride()])
+            : input->getWindowedSamples(lineStart(line), fftSize, window, &buffer[line * fftSize]);
+        if (!copied) {
+            validLines = line;
+            break;
+        }
+    }
+
+    if (validLines > 0)
+        fft.execute();
 
-        fft->process(buffer.get(), buffer.get());
-        const float invFFTSize = 1.0f / fftSize;
-        const float logMultiplier = 10.0f / log2f(10.0f);
-        for (int i = 0; i < fftSize; i++) {
-            // Start from the middle of the FFTW array and wrap
-            // to rearrange the data
-            int k = i ^ (fftSize >> 1);
-            auto s = buffer[k] * invFFTSize;
-            float power = s.real() * s.real() + s.imag() * s.imag();
-            float logPower = log2f(power) * logMultiplier;
-            *dest = logPower;
-            dest++;
+    for (int line = 0; line < validLines; line++)
+        reduceLine(&buffer[line * fft.outputSize()]);
+    std::fill(dest, dest + (lines - validLines) * rows, linear ? 0.0f : neg_infinity);
+    return validLines;
+}
+
+bool SpectrogramPlot::useSlidingDFT(int fftSize, size_t stride)
+{
+    // Sliding costs about stride * fftSize operations a line against
+    // fftSize * log2(fftSize) for the transform; FFTW's constant is
+    // better, so only slide when the stride is well under log2(fftSize)
+    return fftSize >= 64 && stride * 4 <= size_t(log2(fftSize));
+}
+
+template<typename SampleAt, typename LineDone>
+void SpectrogramPlot::getSlidingLines(SampleAt sampleAt, int lines, size_t stride, int fftSize, LineDone lineDone)
+{
+    auto state = slidingStates.acquire();
+    if (state->size != fftSize) {
+        state->size = fftSize;
+        state->seed.reset(new FFT(fftSize));
+        state->twiddle.resize(fftSize);
+        state->spectrum.resize(fftSize);
+        state->line.resize(fftSize);
+        for (int k = 0; k < fftSize; k++)
+            state->twiddle[k] = std::polar(1.0, Tau * k / fftSize);
+    }
+
+    // Start from an exact transform of the first frame, unwindowed
+    auto seed = state->seed->buffer();
+    for (int i = 0; i < fftSize; i++)
+        seed[i] = std::complex<float>(sampleAt(i));
+    state->seed->execute();
+
+    // The spectrum is kept in double so the recurrence doesn't drift
+    // over a tile's worth of updates
+    auto spectrum = state->spectrum.data();
+    auto twiddle = state->twiddle.data();
+    for (int k = 0; k < fftSize; k++)
+        spectrum[k] = seed[k];
+
+    auto out = state->line.data();
+    for (int line = 0; line < lines; line++) {
+        // Each step drops the oldest sample, adds the next one and
+        // rotates every bin back to the new frame start
+        for (size_t n = (line > 0) ? (line - 1) * stride : 0; n < line * stride; n++) {
+            auto delta = sampleAt(n + fftSize) - sampleAt(n);
+            for (int k = 0; k < fftSize; k++) {
+                double re = spectrum[k].real() + delta.real();
+                double im = spectrum[k].imag() + delta.imag();
+                spectrum[k] = std::complex<double>(re * twiddle[k].real() - im * twiddle[k].imag(),
+                                                   re * twiddle[k].imag() + im * twiddle[k].real());
+            }
+        }
+
+        // A Hann window is just a three tap filter across the bins
+        for (int k = 0; k < fftSize; k++) {
+            auto below = spectrum[(k - 1) & (fftSize - 1)];
+            auto above = spectrum[(k + 1) & (fftSize - 1)];
+            out[k] = std::complex<float>(0.5 * spectrum[k] - 0.25 * (below + above));
         }
+        lineDone(out);
     }
 }
 
-int SpectrogramPlot::getStride()
+size_t SpectrogramPlot::getStride()
+{
+    return getStride(fftSize, zoomLevel, fftsPerColumn);
+}
+
+size_t SpectrogramPlot::getStride(int fftSize, int zoomLevel, int fftsPerColumn)
 {
-    return fftSize / zoomLevel;
+    return size_t(fftSize) * fftsPerColumn / zoomLevel;
 }
 
 float SpectrogramPlot::getTunerPhaseInc()
 {
-    auto freq = 0.5f - tuner->centre() / (float)fftSize;
+    auto freq = 0.5f - tuner->centre() / (float)displayRows();
     return freq * Tau;
 }
 
 std::vector<float> SpectrogramPlot::getTunerTaps()
 {
-    float cutoff = tuner->deviation() / (float)fftSize;
+    float cutoff = tuner->deviation() / (float)displayRows();
     float gain = pow(10.0f, powerMax / -10.0f);
     auto atten = 60.0f;
     auto len = estimate_req_filter_len(std::min(cutoff, 0.05f), atten);
@@ -374,7 +1137,27 @@ std::vector<float> SpectrogramPlot::getTunerTaps()
 
 int SpectrogramPlot::linesPerTile()
 {
-    return tileSize / fftSize;
+    return linesPerTile(displayRows());
+}
+
+int SpectrogramPlot::linesPerTile(int displayRows)
+{
+    return tileSize / displayRows;
+}
+
+int SpectrogramPlot::displayRows()
+{
+    return std::min(fullRows(fftSize), rowLimit);
+}
+
+int SpectrogramPlot::fullRows(int fftSize)
+{
+    return std::min(fftSize, maxDisplayRows);
+}
+
+int SpectrogramPlot::batchSize(int fftSize)
+{
+    return std::max(1, maxBatchSamples / fftSize);
 }
 
 bool SpectrogramPlot::mouseEvent(QEvent::Type type, QMouseEvent event)
@@ -393,20 +1176,46 @@ std::shared_ptr<AbstractSampleSource> SpectrogramPlot::output()
 
 void SpectrogramPlot::setFFTSize(int size)
 {
-    float sizeScale = float(size) / float(fftSize);
+    int oldRows = displayRows();
     fftSize = size;
-    fft.reset(new FFT(fftSize));
 
-    window.reset(new float[fftSize]);
+    window = std::make_shared<std::vector<float>>(fftSize);
+    // Periodic Hann, so the sliding DFT can apply it across the bins
     for (int i = 0; i < fftSize; i++) {
-        window[i] = 0.5f * (1.0f - cos(Tau * i / (fftSize - 1)));
+        (*window)[i] = 0.5f * (1.0f - cos(Tau * i / fftSize));
     }
 
+    updateHeight(oldRows);
+    sourceIdentity = inputSource->identity();
+    updatePyramid();
+}
+
+void SpectrogramPlot::setRowLimit(int rows)
+{
+    if (rows == rowLimit)
+        return;
+
+    int oldRows = displayRows();
+    rowLimit = rows;
+    if (displayRows() == oldRows)
+        return;
+
+    // Tiles at other row counts stay cached under their own keys, so
+    // only the requests in flight need dropping
+    retireTileRequests();
+    updateHeight(oldRows);
+}
+
+void SpectrogramPlot::updateHeight(int oldRows)
+{
     if (inputSource->realSignal()) {
-        setHeight(fftSize/2);
+        setHeight(displayRows()/2);
     } else {
-        setHeight(fftSize);
+        setHeight(displayRows());
     }
+
+    // Keep the tuner over the same frequencies
+    float sizeScale = float(displayRows()) / float(oldRows);
     auto dev = tuner->deviation();
     auto centre = tuner->centre();
     tuner->setHeight(height());
@@ -417,20 +1226,20 @@ void SpectrogramPlot::setFFTSize(int size)
 void SpectrogramPlot::setPowerMax(int power)
 {
     powerMax = power;
-    pixmapCache.clear();
+    updateColorTable();
     tunerMoved(666);
 }
 
 void SpectrogramPlot::setPowerMin(int power)
 {
     powerMin = power;
-    pixmapCache.clear();
+    updateColorTable();
 }
 
 void SpectrogramPlot::setSquelch(int sq)
 {
     squelch = sq;
-    pixmapCache.clear();
+    resetPixmapTiles();
 
     tunerMoved(666);
 }
@@ -439,6 +1248,31 @@ void SpectrogramPlot::setZoomLevel(int zoom)
     zoomLevel = zoom;
 }
 
+void SpectrogramPlot::setFFTsPerColumn(int ffts)
+{
+    fftsPerColumn = ffts;
+}
+
+void SpectrogramPlot::setPyramidEnabled(bool enabled)
+{
+    pyramidEnabled = enabled;
+    if (enabled)
+        updatePyramid();
+    else
+        stopPyramid();
+}
+
+void SpectrogramPlot::setAggregation(int aggregation, int percentile)
+{
+    this->aggregation = static_cast<Aggregation>(aggregation);
+    aggregationPercentile = percentile;
+
+    // Aggregated FFT tiles depend on the mode, so they all have to go
+    resetPixmapTiles();
+    QMutexLocker ml(&fftCacheMutex);
+    fftCache.clear();
+}
+
 void SpectrogramPlot::setSampleRate(double rate)
 {
     sampleRate = rate;
@@ -470,17 +1304,19 @@ bool SpectrogramPlot::tunerEnabled()
 
 void SpectrogramPlot::tunerMoved(int deviation)
 {
-    tunerTransform->setFrequency(getTunerPhaseInc());
-    tunerTransform->setTaps(getTunerTaps());
-    tunerTransform->setRelativeBandwith(deviation * 2.0 / height());
+    TunerParams params;
+    params.frequency = getTunerPhaseInc();
+    params.taps = getTunerTaps();
+    params.bandwidth = deviation * 2.0 / height();
+    tunerTransform->setParams(params);
 
     // TODO: for invalidating traceplot cache, this shouldn't really go here
-    QPixmapCache::clear();
+    TracePlot::clearCache();
 
     emit repaint();
 }
 
 uint qHash(const TileCacheKey &key, uint seed)
 {
-    return key.fftSize ^ key.zoomLevel ^ key.sample ^ seed;
+    return key.fftSize ^ (key.rows << 8) ^ key.zoomLevel ^ (key.fftsPerColumn << 16) ^ key.sample ^ seed;
 }
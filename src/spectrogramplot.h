@@ -19,17 +19,24 @@
 
 #pragma once
 
-#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
 #include <QString>
 #include <QWidget>
+#include "asyncrequest.h"
 #include "fft.h"
+#include "memorycache.h"
 #include "inputsource.h"
 #include "plot.h"
+#include "spectrogrampyramid.h"
+#include "statepool.h"
 #include "tuner.h"
 #include "tunertransform.h"
 
+#include <atomic>
 #include <memory>
-#include <array>
 #include <math.h>
 #include <vector>
 
@@ -42,11 +49,13 @@ class SpectrogramPlot : public Plot
 
 public:
     SpectrogramPlot(std::shared_ptr<SampleSource<std::complex<float>>> src, Tuner *tuner);
+    ~SpectrogramPlot();
     void invalidateEvent() override;
     std::shared_ptr<AbstractSampleSource> output() override;
     void paintFront(QPainter &painter, QRect &rect, range_t<size_t> sampleRange) override;
     void paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange) override;
     bool mouseEvent(QEvent::Type type, QMouseEvent event) override;
+    void prefetch(const std::vector<PrefetchRegion> &regions) override;
     std::shared_ptr<SampleSource<std::complex<float>>> input() { return inputSource; };
     void setSampleRate(double sampleRate);
     void setCenterFrequency(double freq);
@@ -57,30 +66,136 @@ public:
     QString *mouseAnnotationComment(const QMouseEvent *event);
 
     void moveTunerToMouse();
+    // Rows covering the full spectrum at the resolution of the FFT
+    // (beyond maxDisplayRows, bins are max-pooled)
+    static int fullRows(int fftSize);
+    // Rows covering the full spectrum as currently displayed
+    int displayRows();
+
+    // How the FFTs in a column are combined when zoomed out past one FFT per column
+    enum Aggregation {
+        Mean,
+        Max,
+        Percentile
+    };
+
+signals:
+    void tileReady(quint64 generation, int fftSize, int zoomLevel, int fftsPerColumn, quint64 tile,
+                   quint64 colorGeneration, QImage colored);
+    void tileRecolored(quint64 generation, quint64 colorGeneration, int fftSize, int zoomLevel, int fftsPerColumn,
+                       quint64 tile, QImage colored);
 
 public slots:
+    void handleTile(quint64 generation, int fftSize, int zoomLevel, int fftsPerColumn, quint64 tile,
+                    quint64 colorGeneration, QImage colored);
+    void handleRecolor(quint64 generation, quint64 colorGeneration, int fftSize, int zoomLevel, int fftsPerColumn,
+                       quint64 tile, QImage colored);
     void setFFTSize(int size);
+    // Pools bins down to at most this many rows (a power of two)
+    void setRowLimit(int rows);
     void setPowerMax(int power);
     void setPowerMin(int power);
     void setSquelch(int power);
     void setZoomLevel(int zoom);
+    void setFFTsPerColumn(int ffts);
+    void setAggregation(int aggregation, int percentile);
+    void setPyramidEnabled(bool enabled);
     void tunerMoved(int deviation);
 
 private:
     const int linesPerGraduation = 50;
-    static const int tileSize = 65536; // This must be a multiple of the maximum FFT size
+    static const int tileSize = 65536; // Values (bins) per cached FFT tile
+    static const int maxDisplayRows = 8192; // Larger FFTs are max-pooled down to this many rows
+    static const int maxBatchSamples = 1 << 18; // Bound on the samples in one batched FFT
+    static const int maxFallbackLevels = 3; // Zoom levels either side searched for stand-in tiles
+    static const int maxReuseLevels = 3; // Zoom levels either side searched for already computed lines
 
     Tuner *tuner;
     std::shared_ptr<SampleSource<std::complex<float>>> inputSource;
     std::vector<AnnotationLocation> visibleAnnotationLocations;
-    std::unique_ptr<FFT> fft;
-    std::unique_ptr<float[]> window;
-    QCache<TileCacheKey, QPixmap> pixmapCache;
-    QCache<TileCacheKey, std::array<float, tileSize>> fftCache;
+    std::shared_ptr<std::vector<float>> window;
+    struct ColoredTile {
+        QPixmap pixmap;
+        quint64 colorGeneration;
+    };
+
+    // Pixmaps are coloured on the workers straight from the centi-dB FFT
+    // tiles, so changing the power range only means a new colour table.
+    // They remember which table they were made with and are drawn as they
+    // are while newer colours are on their way
+    MemoryCache<TileCacheKey, ColoredTile> pixmapCache{CacheBudget::SpectrogramPixmaps};
+    // One colour per centi-dB value (see centiDbColorTable)
+    std::shared_ptr<const std::vector<QRgb>> colorTable;
+    quint64 colorGeneration = 0;
+    // Only ever holds requests for the current colour table
+    QHash<TileCacheKey, std::shared_ptr<AsyncRequest>> recolorRequests;
+    // FFT tiles are shared with the workers computing pixmap tiles. They
+    // are kept as hundredths of a dB in 16 bits (see encodeCentiDb), half
+    // the size of floats and well below anything the colour map shows
+    MemoryCache<TileCacheKey, std::shared_ptr<const std::vector<int16_t>>> fftCache{CacheBudget::FFTTiles};
+    // Held while checking the generation and inserting, and while clearing
+    QMutex fftCacheMutex;
+    QHash<TileCacheKey, std::shared_ptr<AsyncRequest>> tileRequests;
+    // Tiles queued ahead of being needed, kept apart so painting
+    // doesn't cancel them for being off screen
+    QHash<TileCacheKey, std::shared_ptr<AsyncRequest>> prefetchRequests;
+    // Requests dropped from the hashes above keep running until they next
+    // poll, against our caches and source; cancelTiles() waits for them
+    RetiredRequests retired;
+    // Bumped whenever cached tiles stop being valid, so results from
+    // requests started before then are dropped
+    std::atomic<quint64> tileGeneration{0};
+
+    struct FFTState {
+        std::unique_ptr<FFT> fft;
+        // Percentile counts, kept between columns as they run to megabytes
+        std::vector<uint16_t> histogram;
+    };
+    StatePool<FFTState> fftStates;
+
+    // Working state for the sliding DFT, sized for one FFT size
+    struct SlidingState {
+        int size = 0;
+        std::unique_ptr<FFT> seed;
+        std::vector<std::complex<double>> twiddle;
+        std::vector<std::complex<double>> spectrum;
+        std::vector<std::complex<float>> line;
+    };
+    StatePool<SlidingState> slidingStates;
+
+    // Everything a tile is computed from, captured when it's requested
+    // so the settings can change under a running worker
+    struct TileParams {
+        quint64 generation;
+        int fftSize;
+        int zoomLevel;
+        int fftsPerColumn;
+        Aggregation aggregation;
+        int percentile;
+        bool real;
+        int displayRows;
+        int rows;
+        std::shared_ptr<std::vector<float>> window;
+        std::shared_ptr<SpectrogramPyramid> pyramid;
+        QString identity;
+    };
+
+    // Names the samples for the tiles cached on disk (empty if they can't be)
+    QString sourceIdentity;
+
+    // Overview of the whole recording at the current FFT size, if one
+    // has been built (or is being built) for it
+    std::shared_ptr<SpectrogramPyramid> pyramid;
+    std::shared_ptr<AsyncRequest> pyramidRequest;
+    bool pyramidEnabled = false;
     uint colormap[256];
 
     int fftSize;
+    int rowLimit = maxDisplayRows;
     int zoomLevel;
+    int fftsPerColumn = 1;
+    Aggregation aggregation = Mean;
+    int aggregationPercentile = 50;
     float powerMax;
     float powerMin;
     float squelch;
@@ -93,13 +208,41 @@ private:
 
     std::shared_ptr<TunerTransform> tunerTransform;
 
-    QPixmap* getPixmapTile(size_t tile);
-    float* getFFTTile(size_t tile);
-    void getLine(float *dest, size_t sample);
-    int getStride();
+    QPixmap getPixmapTile(size_t tile, QSet<TileCacheKey> &visible);
+    void paintFallback(QPainter &painter, const QRect &target, size_t sample);
+    std::shared_ptr<AsyncRequest> requestTile(size_t tile, int zoomLevel, int fftsPerColumn, int priority);
+    std::shared_ptr<AsyncRequest> requestRecolor(const TileCacheKey &key, std::shared_ptr<const std::vector<int16_t>> fftTile);
+    bool zoomForStride(size_t stride, int &zoom, int &ffts);
+    void cancelTiles();
+    void retireTileRequests();
+    void resetPixmapTiles();
+    std::shared_ptr<const std::vector<int16_t>> getFFTTile(const TileParams &params, size_t tile, AsyncRequest &request);
+    void updateColorTable();
+    static QImage colorizeTile(const std::vector<int16_t> &fftTile, int tileRows, int rows, const std::vector<QRgb> &colorTable);
+    void insertPixmap(const TileCacheKey &key, const QImage &colored, quint64 colorGeneration);
+    std::shared_ptr<std::vector<float>> computeFFTTile(const TileParams &params, size_t tile, AsyncRequest &request);
+    static QString diskTileName(const TileParams &params, size_t tile);
+    int reuseLines(float *dest, const TileParams &params, size_t tile, std::vector<bool> &filled);
+    void getTile(float *dest, size_t tile, int lines, size_t stride, const float *window, FFT &fft, int rows);
+    void getAggregatedLine(float *dest, size_t sample, const TileParams &params, FFT &fft,
+                           std::vector<uint16_t> &histogram);
+    bool getPyramidLine(float *dest, size_t sample, const TileParams &params);
+    void updatePyramid();
+    void buildPyramid();
+    void stopPyramid();
+    int getLines(float *dest, size_t sample, int lines, size_t stride, const float *window, FFT &fft, int rows, bool linear = false);
+    static bool useSlidingDFT(int fftSize, size_t stride);
+    template<typename SampleAt, typename LineDone>
+    void getSlidingLines(SampleAt sampleAt, int lines, size_t stride, int fftSize, LineDone lineDone);
+    FFT& prepareFFT(FFTState &state, int fftSize, int batch, bool real);
+    size_t getStride();
+    static size_t getStride(int fftSize, int zoomLevel, int fftsPerColumn);
     float getTunerPhaseInc();
     std::vector<float> getTunerTaps();
     int linesPerTile();
+    int linesPerTile(int displayRows);
+    void updateHeight(int oldRows);
+    static int batchSize(int fftSize);
     void paintFrequencyScale(QPainter &painter, QRect &rect);
     void paintAnnotations(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
 };
@@ -108,23 +251,31 @@ class TileCacheKey
 {
 
 public:
-    TileCacheKey(int fftSize, int zoomLevel, size_t sample) {
+    TileCacheKey(int fftSize, int rows, int zoomLevel, int fftsPerColumn, size_t sample) {
         this->fftSize = fftSize;
+        this->rows = rows;
         this->zoomLevel = zoomLevel;
+        this->fftsPerColumn = fftsPerColumn;
         this->sample = sample;
     }
 
     bool operator==(const TileCacheKey &k2) const {
         return (this->fftSize == k2.fftSize) &&
+               (this->rows == k2.rows) &&
                (this->zoomLevel == k2.zoomLevel) &&
+               (this->fftsPerColumn == k2.fftsPerColumn) &&
                (this->sample == k2.sample);
     }
 
     int fftSize;
+    int rows;
     int zoomLevel;
+    int fftsPerColumn;
     size_t sample;
 };
 
+uint qHash(const TileCacheKey &key, uint seed = 0);
+
 class AnnotationLocation
 {
 public:
@@ -0,0 +1,207 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+#include "spectrogrampyramid.h"
+
+static const char magic[8] = { 'I', 'N', 'S', 'P', 'P', 'Y', 'R', 'M' };
+static const quint32 version = 2;
+
+// The finest stored level is the first whose two statistics fit in this
+static const qint64 maxLevelBytes = 256 << 20;
+
+struct SpectrogramPyramid::Header {
+    char magic[8];
+    quint32 version;
+    quint32 fftSize;
+    quint32 rows;
+    quint32 firstLevel;
+    quint64 sampleCount;
+    quint64 builtLines;
+    quint32 complete;
+    quint32 identityLength;
+    char identity[2048];
+    quint64 levelOffsets[maxLevel + 1];
+};
+
+// Keeps the level data page-aligned
+static const qint64 headerSize = 4096;
+
+QString SpectrogramPyramid::sidecarPath(const QString &fileName, const QString &identity, int fftSize)
+{
+    // Next to the recording if we can, otherwise in the cache directory
+    QFileInfo fileInfo(fileName);
+    if (QFileInfo(fileInfo.absolutePath()).isWritable())
+        return QString("%1.%2.pyramid").arg(fileInfo.absoluteFilePath()).arg(fftSize);
+
+    auto cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pyramids";
+    if (!QDir().mkpath(cacheDir))
+        return QString();
+    auto hash = QCryptographicHash::hash(identity.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("%1/%2.%3.pyramid").arg(cacheDir).arg(QString(hash)).arg(fftSize);
+}
+
+std::shared_ptr<SpectrogramPyramid> SpectrogramPyramid::open(const QString &fileName, const QString &identity,
+                                                             int fftSize, int rows, size_t sampleCount, bool create)
+{
+    static_assert(sizeof(Header) <= headerSize, "pyramid header too big");
+
+    auto identityBytes = identity.toUtf8();
+    if (fileName.isEmpty() || identityBytes.size() > int(sizeof(Header::identity)))
+        return nullptr;
+
+    auto path = sidecarPath(fileName, identity, fftSize);
+    if (path.isEmpty() || (!create && !QFile::exists(path)))
+        return nullptr;
+
+    std::shared_ptr<SpectrogramPyramid> pyramid(new SpectrogramPyramid());
+    pyramid->sourceIdentity = identity;
+    pyramid->size = fftSize;
+    pyramid->rowCount = rows;
+    pyramid->sampleCount = sampleCount;
+
+    // Lay the levels out after the header
+    pyramid->first = maxLevel;
+    for (int level = 1; level < maxLevel; level++) {
+        if (qint64(pyramid->lines(level)) * rows * sizeof(float) * 2 <= maxLevelBytes) {
+            pyramid->first = level;
+            break;
+        }
+    }
+    quint64 offsets[maxLevel + 1] = { };
+    qint64 totalSize = headerSize;
+    for (int level = pyramid->first; level <= maxLevel; level++) {
+        offsets[level] = totalSize;
+        totalSize += qint64(pyramid->lines(level)) * rows * sizeof(float) * 2;
+    }
+
+    pyramid->file = std::make_unique<QFile>(path);
+    if (!pyramid->file->open(QIODevice::ReadWrite))
+        return nullptr;
+
+    bool fresh = (pyramid->file->size() != totalSize);
+    if (fresh) {
+        if (!create)
+            return nullptr;
+        // Truncate first so the new file reads back as zeros
+        if (!pyramid->file->resize(0) || !pyramid->file->resize(totalSize))
+            return nullptr;
+    }
+
+    pyramid->data = pyramid->file->map(0, totalSize);
+    if (pyramid->data == nullptr)
+        return nullptr;
+    auto header = reinterpret_cast<Header*>(pyramid->data);
+    pyramid->header = header;
+
+    bool matches = !fresh &&
+        memcmp(header->magic, magic, sizeof(magic)) == 0 &&
+        header->version == version &&
+        header->fftSize == quint32(fftSize) &&
+        header->rows == quint32(rows) &&
+        header->firstLevel == quint32(pyramid->first) &&
+        header->sampleCount == sampleCount &&
+        header->identityLength == quint32(identityBytes.size()) &&
+        memcmp(header->identity, identityBytes.constData(), identityBytes.size()) == 0;
+
+    if (!matches) {
+        if (!create)
+            return nullptr;
+        memset(header, 0, headerSize);
+        memcpy(header->magic, magic, sizeof(magic));
+        header->version = version;
+        header->fftSize = fftSize;
+        header->rows = rows;
+        header->firstLevel = pyramid->first;
+        header->sampleCount = sampleCount;
+        header->identityLength = identityBytes.size();
+        memcpy(header->identity, identityBytes.constData(), identityBytes.size());
+        std::copy(offsets, offsets + maxLevel + 1, header->levelOffsets);
+    }
+
+    pyramid->complete = (header->complete != 0);
+    return pyramid;
+}
+
+SpectrogramPyramid::~SpectrogramPyramid()
+{
+    if (data != nullptr)
+        file->unmap(data);
+}
+
+size_t SpectrogramPyramid::lines(int level) const
+{
+    return sampleCount / (size_t(size) << level);
+}
+
+float* SpectrogramPyramid::levelData(int level, Statistic statistic) const
+{
+    auto base = reinterpret_cast<float*>(data + header->levelOffsets[level]);
+    return base + (statistic == Max ? lines(level) * rowCount : 0);
+}
+
+const float* SpectrogramPyramid::line(int level, Statistic statistic, size_t line) const
+{
+    if (level < first || level > maxLevel || line >= lines(level))
+        return nullptr;
+    return levelData(level, statistic) + line * rowCount;
+}
+
+size_t SpectrogramPyramid::builtLines() const
+{
+    return header->builtLines;
+}
+
+float* SpectrogramPyramid::firstLevelLine(Statistic statistic, size_t line)
+{
+    return levelData(first, statistic) + line * rowCount;
+}
+
+void SpectrogramPyramid::setBuiltLines(size_t lines)
+{
+    header->builtLines = lines;
+}
+
+void SpectrogramPyramid::finish()
+{
+    // Each coarser line is the pair of lines below it, so means of
+    // means stay exact (the odd line at the end is dropped)
+    for (int level = first + 1; level <= maxLevel; level++) {
+        const float *finerMean = levelData(level - 1, Mean);
+        const float *finerMax = levelData(level - 1, Max);
+        float *mean = levelData(level, Mean);
+        float *max = levelData(level, Max);
+        size_t count = lines(level) * rowCount;
+        for (size_t i = 0; i < count; i++) {
+            size_t row = i % rowCount;
+            size_t a = (i - row) * 2 + row;
+            size_t b = a + rowCount;
+            mean[i] = (finerMean[a] + finerMean[b]) * 0.5f;
+            max[i] = std::max(finerMax[a], finerMax[b]);
+        }
+    }
+    header->complete = 1;
+    complete.store(true, std::memory_order_release);
+}
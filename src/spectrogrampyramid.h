@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+/*
+ * Zoomed-out power overview of a whole recording, memory-mapped from a
+ * sidecar file so it survives between sessions.
+ *
+ * Level n has one line per 2^n consecutive (non-overlapping) FFTs,
+ * holding the mean and the max of their linear power in each display
+ * row. Only the levels from firstLevel() up are stored, so the sidecar
+ * stays a bounded fraction of the recording's size.
+ *
+ * The sidecar records the identity of the samples it was made from and
+ * is rebuilt if that, the FFT size or the layout doesn't match.
+ */
+class SpectrogramPyramid
+{
+public:
+    enum Statistic {
+        Mean,
+        Max
+    };
+    static const int maxLevel = 16;
+
+    // Maps the existing sidecar for these samples, or if create is set
+    // makes a new empty one. Returns nullptr if neither worked.
+    static std::shared_ptr<SpectrogramPyramid> open(const QString &fileName, const QString &identity,
+                                                    int fftSize, int rows, size_t sampleCount, bool create);
+    ~SpectrogramPyramid();
+
+    QString identity() const { return sourceIdentity; };
+    int fftSize() const { return size; };
+    int rows() const { return rowCount; };
+    int firstLevel() const { return first; };
+    size_t lines(int level) const;
+    bool isComplete() const { return complete.load(std::memory_order_acquire); };
+
+    // Linear power for one line of a level, or nullptr if it isn't stored
+    const float* line(int level, Statistic statistic, size_t line) const;
+
+    // Building: fill in lines of the first level in order, recording
+    // progress so an interrupted build can carry on where it left off,
+    // then finish() derives the coarser levels
+    size_t builtLines() const;
+    float* firstLevelLine(Statistic statistic, size_t line);
+    void setBuiltLines(size_t lines);
+    void finish();
+
+private:
+    struct Header;
+
+    SpectrogramPyramid() { };
+    SpectrogramPyramid(const SpectrogramPyramid &) = delete;
+    SpectrogramPyramid& operator=(const SpectrogramPyramid &) = delete;
+
+    static QString sidecarPath(const QString &fileName, const QString &identity, int fftSize);
+    float* levelData(int level, Statistic statistic) const;
+
+    std::unique_ptr<QFile> file;
+    uchar *data = nullptr;
+    Header *header = nullptr;
+    QString sourceIdentity;
+    int size = 0;
+    int rowCount = 0;
+    int first = 0;
+    size_t sampleCount = 0;
+    std::atomic<bool> complete{false};
+};
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*
+ * Parameters for a processing stage, written from the GUI thread and
+ * read from whichever thread runs the stage's work().
+ *
+ * Writers publish an immutable snapshot and bump a generation counter.
+ * Readers keep the generation they last configured themselves with, so
+ * the common case (nothing changed) is a single atomic load.
+ */
+template<typename T>
+class StageParams
+{
+public:
+    StageParams(T initial = T()) : current(std::make_shared<const T>(initial)) { }
+
+    // Returns false (and leaves the generation alone) if nothing changed
+    bool set(const T &value) {
+        if (*snapshot() == value)
+            return false;
+        std::atomic_store(&current, std::shared_ptr<const T>(std::make_shared<const T>(value)));
+        gen.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    std::shared_ptr<const T> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    uint64_t generation() const {
+        return gen.load(std::memory_order_acquire);
+    }
+
+    // Refreshes `local` if the parameters have changed since `lastGeneration`
+    bool update(uint64_t &lastGeneration, std::shared_ptr<const T> &local) const {
+        auto g = generation();
+        if (local && g == lastGeneration)
+            return false;
+        // Read the generation before the snapshot so we can never miss an update
+        lastGeneration = g;
+        local = snapshot();
+        return true;
+    }
+
+private:
+    std::shared_ptr<const T> current;
+    std::atomic<uint64_t> gen{0};
+};
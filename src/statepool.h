@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <memory>
+#include <vector>
+
+/*
+ * Free list of per-call working state (DSP objects, scratch buffers)
+ * so a stage can run work() on several threads at once while still
+ * reusing its objects between calls.
+ */
+template<typename T>
+class StatePool
+{
+public:
+    class Handle
+    {
+    public:
+        Handle(StatePool &pool, std::unique_ptr<T> state) : pool(&pool), state(std::move(state)) { }
+        Handle(Handle &&other) : pool(other.pool), state(std::move(other.state)) { }
+        Handle(const Handle &) = delete;
+        Handle& operator=(const Handle &) = delete;
+        ~Handle() {
+            if (state)
+                pool->release(std::move(state));
+        }
+
+        T* operator->() { return state.get(); }
+        T& operator*() { return *state; }
+
+    private:
+        StatePool *pool;
+        std::unique_ptr<T> state;
+    };
+
+    Handle acquire() {
+        QMutexLocker ml(&mutex);
+        if (available.empty())
+            return Handle(*this, std::make_unique<T>());
+
+        auto state = std::move(available.back());
+        available.pop_back();
+        return Handle(*this, std::move(state));
+    }
+
+private:
+    void release(std::unique_ptr<T> state) {
+        QMutexLocker ml(&mutex);
+        available.push_back(std::move(state));
+    }
+
+    QMutex mutex;
+    std::vector<std::unique_ptr<T>> available;
+};
@@ -0,0 +1,161 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <algorithm>
+#include "tilediskcache.h"
+
+static const quint32 tileMagic = 0x494e5356; // Bumped when tile contents change
+
+// Evicting down to a bit under the limit stops every store evicting
+static const double evictionTarget = 0.9;
+
+TileDiskCache& TileDiskCache::instance()
+{
+    static TileDiskCache cache;
+    return cache;
+}
+
+TileDiskCache::TileDiskCache()
+{
+    QSettings settings;
+    byteLimit = settings.value("TileDiskCacheMB", 1024).toLongLong() << 20;
+
+    auto cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheDir.isEmpty())
+        directory = cacheDir + "/tiles";
+}
+
+void TileDiskCache::setLimit(qint64 bytes)
+{
+    QMutexLocker ml(&mutex);
+    byteLimit = bytes;
+    if (usage > byteLimit)
+        evict();
+}
+
+qint64 TileDiskCache::limit()
+{
+    QMutexLocker ml(&mutex);
+    return byteLimit;
+}
+
+QString TileDiskCache::tilePath(const QString &identity, const QString &name)
+{
+    auto hash = QCryptographicHash::hash(identity.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("%1/%2/%3.tile").arg(directory).arg(QString(hash)).arg(name);
+}
+
+std::shared_ptr<std::vector<int16_t>> TileDiskCache::load(const QString &identity, const QString &name, size_t size)
+{
+    if (identity.isEmpty() || directory.isEmpty() || limit() == 0)
+        return nullptr;
+
+    QFile file(tilePath(identity, name));
+    if (!file.open(QIODevice::ReadWrite))
+        return nullptr;
+
+    quint32 header[2];
+    if (file.read(reinterpret_cast<char*>(header), sizeof(header)) != sizeof(header))
+        return nullptr;
+    if (header[0] != tileMagic || header[1] != size)
+        return nullptr;
+
+    auto tile = std::make_shared<std::vector<int16_t>>(size);
+    qint64 bytes = size * sizeof(int16_t);
+    if (file.read(reinterpret_cast<char*>(tile->data()), bytes) != bytes)
+        return nullptr;
+
+    // The modification time doubles as the last use for eviction
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return tile;
+}
+
+void TileDiskCache::store(const QString &identity, const QString &name, const std::vector<int16_t> &tile)
+{
+    if (identity.isEmpty() || directory.isEmpty() || limit() == 0)
+        return;
+
+    auto path = tilePath(identity, name);
+    if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+        return;
+
+    // Written to a temporary and renamed, so readers never see half a tile
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    quint32 header[2] = { tileMagic, quint32(tile.size()) };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(int16_t));
+    if (!file.commit())
+        return;
+
+    QMutexLocker ml(&mutex);
+    if (usage < 0)
+        scanUsage();
+    else
+        usage += sizeof(header) + tile.size() * sizeof(int16_t);
+    if (usage > byteLimit)
+        evict();
+}
+
+void TileDiskCache::scanUsage()
+{
+    usage = 0;
+    QDirIterator it(directory, QStringList() << "*.tile", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        usage += it.fileInfo().size();
+    }
+}
+
+void TileDiskCache::evict()
+{
+    std::vector<QFileInfo> files;
+    QDirIterator it(directory, QStringList() << "*.tile", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        files.push_back(it.fileInfo());
+    }
+    std::sort(files.begin(), files.end(), [](const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() < b.lastModified();
+    });
+
+    usage = 0;
+    for (auto &file : files)
+        usage += file.size();
+
+    qint64 target = byteLimit * evictionTarget;
+    for (auto &file : files) {
+        if (usage <= target)
+            break;
+        if (QFile::remove(file.absoluteFilePath()))
+            usage -= file.size();
+    }
+}
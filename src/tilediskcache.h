@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  This file is part of inspectrum.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Second-level cache of spectrogram FFT tiles in the user's cache
+ * directory, so tiles computed in an earlier session don't need
+ * computing again.
+ *
+ * Tiles are stored one file each, grouped by a hash of the source's
+ * identity. Reading a tile marks it as recently used, and once the
+ * total size goes over the limit the least recently used tiles are
+ * removed. Safe to use from any thread.
+ */
+class TileDiskCache
+{
+public:
+    static TileDiskCache& instance();
+
+    // Returns nullptr unless a tile of exactly `size` values is stored
+    std::shared_ptr<std::vector<int16_t>> load(const QString &identity, const QString &name, size_t size);
+    void store(const QString &identity, const QString &name, const std::vector<int16_t> &tile);
+
+    // Zero turns the cache off
+    void setLimit(qint64 bytes);
+    qint64 limit();
+
+private:
+    TileDiskCache();
+    TileDiskCache(const TileDiskCache &) = delete;
+    TileDiskCache& operator=(const TileDiskCache &) = delete;
+
+    QString tilePath(const QString &identity, const QString &name);
+    void scanUsage();
+    void evict();
+
+    QMutex mutex;
+    QString directory;
+    qint64 byteLimit;
+    qint64 usage = -1; // Not known until the directory has been scanned
+};
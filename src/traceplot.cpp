@@ -17,10 +17,11 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <QPixmapCache>
 #include <QTextStream>
 #include <QtConcurrent>
 #include <QPainterPath>
+#include "kernels.h"
+#include "memorycache.h"
 #include "samplesource.h"
 #include "traceplot.h"
 
@@ -28,6 +29,16 @@ TracePlot::TracePlot(std::shared_ptr<AbstractSampleSource> source) : Plot(source
     connect(this, &TracePlot::imageReady, this, &TracePlot::handleImage);
 }
 
+TracePlot::~TracePlot()
+{
+    // Outstanding requests reference both us and the source
+    for (auto &request : tasks)
+        retired.add(request);
+    for (auto &request : prefetchTasks)
+        retired.add(request);
+    retired.waitForFinished();
+}
+
 void TracePlot::paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange)
 {
     if (sampleRange.length() == 0) return;
@@ -37,11 +48,12 @@ void TracePlot::paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleR
     size_t tileID = sampleRange.minimum / samplesPerTile;
     size_t tileOffset = sampleRange.minimum % samplesPerTile; // Number of samples to skip from first image tile
     int xOffset = tileOffset / samplesPerColumn; // Number of columns to skip from first image tile
+    QSet<QString> visible;
 
     // Paint first (possibly partial) tile
     painter.drawPixmap(
         QRect(rect.x(), rect.y(), tileWidth - xOffset, height()),
-        getTile(tileID++, samplesPerTile),
+        getTile(tileID++, samplesPerTile, visible),
         QRect(xOffset, 0, tileWidth - xOffset, height())
     );
 
@@ -49,70 +61,147 @@ void TracePlot::paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleR
     for (int x = tileWidth - xOffset; x < rect.right(); x += tileWidth) {
         painter.drawPixmap(
             QRect(x, rect.y(), tileWidth, height()),
-            getTile(tileID++, samplesPerTile)
+            getTile(tileID++, samplesPerTile, visible)
         );
     }
+
+    cancelStaleTasks(visible);
 }
 
-QPixmap TracePlot::getTile(size_t tileID, size_t sampleCount)
+// Shared by every trace, like QPixmapCache was
+static MemoryCache<QString, QPixmap>& pixmapCache()
+{
+    static MemoryCache<QString, QPixmap> cache(CacheBudget::TracePixmaps);
+    return cache;
+}
+
+void TracePlot::clearCache()
+{
+    pixmapCache().clear();
+}
+
+QString TracePlot::tileKey(size_t tileID, size_t sampleCount)
 {
-    QPixmap pixmap(tileWidth, height());
     QString key;
     QTextStream(&key) << "traceplot_" << this << "_" << tileID << "_" << sampleCount;
-    if (QPixmapCache::find(key, &pixmap))
+    return key;
+}
+
+QPixmap TracePlot::getTile(size_t tileID, size_t sampleCount, QSet<QString> &visible)
+{
+    QPixmap pixmap(tileWidth, height());
+    QString key = tileKey(tileID, sampleCount);
+    if (pixmapCache().find(key, &pixmap))
         return pixmap;
 
+    visible.insert(key);
     if (!tasks.contains(key)) {
-        range_t<size_t> sampleRange{tileID * sampleCount, (tileID + 1) * sampleCount};
-        QtConcurrent::run(this, &TracePlot::drawTile, key, QRect(0, 0, tileWidth, height()), sampleRange);
-        tasks.insert(key);
+        // Take over a prefetch if one is already running
+        auto prefetched = prefetchTasks.take(key);
+        if (prefetched && prefetched->isStarted()) {
+            tasks.insert(key, prefetched);
+        } else {
+            if (prefetched)
+                retired.add(prefetched);
+            range_t<size_t> sampleRange{tileID * sampleCount, (tileID + 1) * sampleCount};
+            tasks.insert(key, requestTile(key, QRect(0, 0, tileWidth, height()), sampleRange, AsyncRequest::Visible));
+        }
     }
     pixmap.fill(Qt::transparent);
     return pixmap;
 }
 
-void TracePlot::drawTile(QString key, const QRect &rect, range_t<size_t> sampleRange)
+void TracePlot::prefetch(const std::vector<PrefetchRegion> &regions)
 {
-    QImage image(rect.size(), QImage::Format_ARGB32);
-    image.fill(Qt::transparent);
+    QSet<QString> wanted;
+    for (auto &region : regions) {
+        size_t samplesPerTile = tileWidth * std::max<size_t>(1, region.samplesPerColumn);
+        for (size_t tileID = region.sampleRange.minimum / samplesPerTile;
+             tileID * samplesPerTile < region.sampleRange.maximum; tileID++) {
+            QString key = tileKey(tileID, samplesPerTile);
+            if (tasks.contains(key) || pixmapCache().contains(key))
+                continue;
+            wanted.insert(key);
+            if (!prefetchTasks.contains(key)) {
+                range_t<size_t> sampleRange{tileID * samplesPerTile, (tileID + 1) * samplesPerTile};
+                prefetchTasks.insert(key, requestTile(key, QRect(0, 0, tileWidth, height()), sampleRange, AsyncRequest::Prefetch));
+            }
+        }
+    }
+
+    for (auto it = prefetchTasks.begin(); it != prefetchTasks.end();) {
+        if (!wanted.contains(it.key())) {
+            retired.add(it.value());
+            it = prefetchTasks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
 
-    QPainter painter(&image);
-    painter.setRenderHint(QPainter::Antialiasing, true);
+void TracePlot::cancelStaleTasks(const QSet<QString> &visible)
+{
+    // Anything that has scrolled out of view (or belongs to an old
+    // zoom level) isn't worth finishing
+    for (auto it = tasks.begin(); it != tasks.end();) {
+        if (!visible.contains(it.key())) {
+            retired.add(it.value());
+            it = tasks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
 
+std::shared_ptr<AsyncRequest> TracePlot::requestTile(QString key, const QRect &rect, range_t<size_t> sampleRange, int priority)
+{
     auto firstSample = sampleRange.minimum;
     auto length = sampleRange.length();
 
     // Is it a 2-channel (complex) trace?
     if (auto src = dynamic_cast<SampleSource<std::complex<float>>*>(sampleSource.get())) {
-        auto samples = src->getSamples(firstSample, length);
-        if (samples == nullptr)
-            return;
-
-        painter.setPen(Qt::red);
-        plotTrace(painter, rect, reinterpret_cast<float*>(samples.get()), length, 2);
-        painter.setPen(Qt::blue);
-        plotTrace(painter, rect, reinterpret_cast<float*>(samples.get())+1, length, 2);
+        return src->requestSamples(firstSample, length, [=](std::unique_ptr<std::complex<float>[]> samples) {
+            if (samples == nullptr)
+                return;
+
+            QImage image(rect.size(), QImage::Format_ARGB32);
+            image.fill(Qt::transparent);
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing, true);
+            painter.setPen(Qt::red);
+            plotTrace(painter, rect, reinterpret_cast<float*>(samples.get()), length, 2);
+            painter.setPen(Qt::blue);
+            plotTrace(painter, rect, reinterpret_cast<float*>(samples.get())+1, length, 2);
+            painter.end();
+            emit imageReady(key, image);
+        }, priority);
 
     // Otherwise is it single channel?
     } else if (auto src = dynamic_cast<SampleSource<float>*>(sampleSource.get())) {
-        auto samples = src->getSamples(firstSample, length);
-        if (samples == nullptr)
-            return;
-
-        painter.setPen(Qt::green);
-        plotTrace(painter, rect, samples.get(), length, 1);
+        return src->requestSamples(firstSample, length, [=](std::unique_ptr<float[]> samples) {
+            if (samples == nullptr)
+                return;
+
+            QImage image(rect.size(), QImage::Format_ARGB32);
+            image.fill(Qt::transparent);
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing, true);
+            painter.setPen(Qt::green);
+            plotTrace(painter, rect, samples.get(), length, 1);
+            painter.end();
+            emit imageReady(key, image);
+        }, priority);
     } else {
         throw std::runtime_error("TracePlot::paintMid: Unsupported source type");
     }
-
-    emit imageReady(key, image);
 }
 
 void TracePlot::handleImage(QString key, QImage image)
 {
     auto pixmap = QPixmap::fromImage(image);
-    QPixmapCache::insert(key, pixmap);
+    pixmapCache().insert(key, pixmap, qint64(image.bytesPerLine()) * image.height());
     tasks.remove(key);
+    prefetchTasks.remove(key);
     emit repaint();
 }
 
@@ -122,6 +211,31 @@ void TracePlot::plotTrace(QPainter &painter, const QRect &rect, float *samples,
     range_t<float> xRange{0, rect.width() - 2.f};
     range_t<float> yRange{0, rect.height() - 2.f};
     const float xStep = 1.0 / count * rect.width();
+
+    // With more samples than columns, draw the min/max envelope of each
+    // column rather than a line through every sample
+    const size_t columns = rect.width();
+    if (count > columns * 2) {
+        for (size_t col = 0; col < columns; col++) {
+            size_t first = col * count / columns;
+            size_t last = (col + 1) * count / columns;
+            float min, max;
+            minMax(&samples[first * step], last - first, step, min, max);
+
+            float x = xRange.clip(col) + rect.x();
+            float yMax = yRange.clip((1 - max) * (rect.height() / 2)) + rect.y();
+            float yMin = yRange.clip((1 - min) * (rect.height() / 2)) + rect.y();
+
+            if (col == 0)
+                path.moveTo(x, yMax);
+            else
+                path.lineTo(x, yMax);
+            path.lineTo(x, yMin);
+        }
+        painter.drawPath(path);
+        return;
+    }
+
     for (size_t i = 0; i < count; i++) {
         float sample = samples[i*step];
         float x = i * xStep;
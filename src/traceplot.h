@@ -18,8 +18,10 @@
  */
 
 #pragma once
+#include <QHash>
 #include <memory>
 #include "abstractsamplesource.h"
+#include "asyncrequest.h"
 #include "plot.h"
 #include "util.h"
 
@@ -29,9 +31,13 @@ class TracePlot : public Plot
 
 public:
     TracePlot(std::shared_ptr<AbstractSampleSource> source);
+    ~TracePlot();
 
     void paintMid(QPainter &painter, QRect &rect, range_t<size_t> sampleRange);
+    void prefetch(const std::vector<PrefetchRegion> &regions) override;
     std::shared_ptr<AbstractSampleSource> source() { return sampleSource; };
+    // Drops the rendered tiles of every trace
+    static void clearCache();
 
 signals:
     void imageReady(QString key, QImage image);
@@ -40,10 +46,15 @@ public slots:
     void handleImage(QString key, QImage image);
 
 private:
-    QSet<QString> tasks;
+    QHash<QString, std::shared_ptr<AsyncRequest>> tasks;
+    QHash<QString, std::shared_ptr<AsyncRequest>> prefetchTasks;
+    // Dropped tasks may still be drawing, and reference us and the source
+    RetiredRequests retired;
     const int tileWidth = 1000;
 
-    QPixmap getTile(size_t tileID, size_t sampleCount);
-    void drawTile(QString key, const QRect &rect, range_t<size_t> sampleRange);
+    QString tileKey(size_t tileID, size_t sampleCount);
+    QPixmap getTile(size_t tileID, size_t sampleCount, QSet<QString> &visible);
+    std::shared_ptr<AsyncRequest> requestTile(QString key, const QRect &rect, range_t<size_t> sampleRange, int priority);
+    void cancelStaleTasks(const QSet<QString> &visible);
     void plotTrace(QPainter &painter, const QRect &rect, float *samples, size_t count, int step);
 };
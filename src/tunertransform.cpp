@@ -18,10 +18,9 @@
  */
 
 #include "tunertransform.h"
-#include <liquid/liquid.h>
 #include "util.h"
 
-TunerTransform::TunerTransform(std::shared_ptr<SampleSource<std::complex<float>>> src) : SampleBuffer(src), frequency(0), bandwidth(1.), taps{1.0f}
+TunerTransform::TunerTransform(std::shared_ptr<SampleSource<std::complex<float>>> src) : SampleBuffer(src)
 {
 
 }
@@ -31,42 +30,50 @@ void TunerTransform::work(void *input, void *output, int count, size_t sampleid)
     auto out = static_cast<std::complex<float>*>(output);
     auto temp = std::make_unique<std::complex<float>[]>(count);
 
+    auto state = states.acquire();
+    params.update(state->paramsGeneration, state->params);
+    // Tuner drags usually only move the frequency, which the filter doesn't care about
+    auto &taps = state->params->taps;
+    if (state->filter == nullptr)
+        state->filter = firfilt_crcf_create(const_cast<float*>(taps.data()), taps.size());
+    else if (state->filterParams != state->params && taps != state->filterParams->taps)
+        state->filter = firfilt_crcf_recreate(state->filter, const_cast<float*>(taps.data()), taps.size());
+    state->filterParams = state->params;
+    // Blocks aren't contiguous, so start every one from a clean filter
+    firfilt_crcf_reset(state->filter);
+
     // Mix down
-    nco_crcf mix = nco_crcf_create(LIQUID_NCO);
-    nco_crcf_set_phase(mix, fmodf(frequency * sampleid, Tau));
-    nco_crcf_set_frequency(mix, frequency);
-    nco_crcf_mix_block_down(mix,
+    if (state->mix == nullptr)
+        state->mix = nco_crcf_create(LIQUID_NCO);
+    auto frequency = state->params->frequency;
+    nco_crcf_set_phase(state->mix, fmodf(frequency * sampleid, Tau));
+    nco_crcf_set_frequency(state->mix, frequency);
+    nco_crcf_mix_block_down(state->mix,
                             static_cast<std::complex<float>*>(input),
                             temp.get(),
                             count);
-    nco_crcf_destroy(mix);
 
     // Filter
-    firfilt_crcf filter = firfilt_crcf_create(taps.data(), taps.size());
     for (int i = 0; i < count; i++)
     {
-        firfilt_crcf_push(filter, temp[i]);
-        firfilt_crcf_execute(filter, &out[i]);
+        firfilt_crcf_push(state->filter, temp[i]);
+        firfilt_crcf_execute(state->filter, &out[i]);
     }
-    firfilt_crcf_destroy(filter);
 }
 
-void TunerTransform::setFrequency(float frequency)
+size_t TunerTransform::history()
 {
-    this->frequency = frequency;
+    return std::max((size_t)256, params.snapshot()->taps.size());
 }
 
-void TunerTransform::setTaps(std::vector<float> taps)
+void TunerTransform::setParams(const TunerParams &params)
 {
-    this->taps = taps;
+    // Let anything holding on to our output (e.g. a materialized
+    // stream) know it is out of date
+    if (this->params.set(params))
+        invalidate();
 }
 
 float TunerTransform::relativeBandwidth() {
-    return bandwidth;
+    return params.snapshot()->bandwidth;
 }
-
-void TunerTransform::setRelativeBandwith(float bandwidth)
-{
-    this->bandwidth = bandwidth;
-}
-
@@ -19,21 +19,57 @@
 
 #pragma once
 
+#include <liquid/liquid.h>
 #include "samplebuffer.h"
+#include "stageparams.h"
+#include "statepool.h"
 #include <vector>
 
+struct TunerParams
+{
+    float frequency = 0.0f;
+    float bandwidth = 1.0f;
+    std::vector<float> taps{1.0f};
+
+    bool operator==(const TunerParams &other) const {
+        return (frequency == other.frequency) &&
+               (bandwidth == other.bandwidth) &&
+               (taps == other.taps);
+    }
+};
+
 class TunerTransform : public SampleBuffer<std::complex<float>, std::complex<float>>
 {
 private:
-    float frequency;
-    float bandwidth;
-    std::vector<float> taps;
+    StageParams<TunerParams> params;
+
+    // Rebuilt only when the params generation moves on
+    struct State
+    {
+        ~State() {
+            if (mix != nullptr)
+                nco_crcf_destroy(mix);
+            if (filter != nullptr)
+                firfilt_crcf_destroy(filter);
+        }
+
+        uint64_t paramsGeneration = 0;
+        std::shared_ptr<const TunerParams> params;
+        // Last snapshot the filter was used with; its taps are the filter's
+        std::shared_ptr<const TunerParams> filterParams;
+        nco_crcf mix = nullptr;
+        firfilt_crcf filter = nullptr;
+    };
+
+    StatePool<State> states;
 
 public:
     TunerTransform(std::shared_ptr<SampleSource<std::complex<float>>> src);
     void work(void *input, void *output, int count, size_t sampleid) override;
-    void setFrequency(float frequency);
-    void setTaps(std::vector<float> taps);
-    void setRelativeBandwith(float bandwidth);
+    size_t history() override;
+    void setParams(const TunerParams &params);
+    std::shared_ptr<const TunerParams> currentParams() {
+        return params.snapshot();
+    }
     float relativeBandwidth() override;
 };